@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <sstream>
+#include <unordered_set> // for MinimalBasis
 
 #include "constants.hpp"
 #include "construction.hpp"
@@ -464,16 +465,19 @@ Basis<T> CombineBases(const std::vector<Basis<T>>& oldBases) {
     return Basis<T>(newBasisVectors);
 }
 
-// return the minimal basis of monomials needed to express the given polynomials
+// return the minimal basis of monomials needed to express the given polynomials,
+// in the order in which they first appear; this is the union of their terms, so
+// a monomial is kept even if its coefficients in different polynomials add up
+// to 0
 inline Basis<Mono> MinimalBasis(const std::vector<Poly>& polynomials) {
-    Poly combinedPoly;
+    std::unordered_set<Mono, MonoHash> seen;
+    std::vector<Mono> allUsedMonos;
     for (const auto& poly : polynomials) {
-        combinedPoly += poly;
-    }
-    std::vector<Mono> allUsedMonos(combinedPoly.size());
-    for (auto i = 0u; i < combinedPoly.size(); ++i) {
-        allUsedMonos[i] = combinedPoly[i];
-        allUsedMonos[i].Coeff() = 1;
+        for (const Mono& term : poly) {
+            if (!seen.insert(term).second) continue;
+            allUsedMonos.push_back(term);
+            allUsedMonos.back().Coeff() = 1;
+        }
     }
     return Basis<Mono>(allUsedMonos);
 }
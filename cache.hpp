@@ -0,0 +1,222 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <string>
+#include <stdexcept>
+#include <utility> // std::move
+#include <functional> // std::hash
+#include <mutex>
+#include <shared_mutex> // std::shared_timed_mutex
+
+// Memoization table which can be shared by any number of threads; this is what
+// all of the caches in the matrix, discretization, and hypergeometric code use.
+//
+// The keys are split over a fixed number of shards, each behind its own
+// reader-writer lock, so threads working on different keys almost never wait
+// on each other, and lookups of keys which are already present (by far the
+// most common case once a calculation gets going) only take a shared lock.
+// Within a shard the keys are in a FlatMap (below), so a lookup hashes the key
+// once and probes one contiguous array without allocating anything.
+//
+// Values are computed outside of any lock, so the function computing a value is
+// free to consult other caches, or even this one. If two threads compute the
+// same key at once, the first value stored is kept and the other is thrown
+// away; the caches in this program only hold deterministic results, so callers
+// can't tell the difference. Entries are never erased or moved, so references
+// returned by Get() stay valid for as long as the cache exists.
+
+// spreads the bits of a hash over the whole word; std::hash of an integer is
+// usually the integer itself, which would make a terrible index into a table
+// whose size is a power of 2
+inline std::uint64_t MixHash(std::uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Insert-only hash table with open addressing and linear probing. The slot
+// array only holds each entry's hash and position; the entries themselves go
+// in a deque, which never moves them, so the slots can be rehashed without
+// invalidating references to values. Callers pass in the (mixed) hash, so it
+// only has to be computed once per lookup-and-insert.
+template<typename Key, typename Value>
+class FlatMap {
+    public:
+        // nullptr if key isn't present
+        const Value* Find(const Key& key, const std::uint64_t hash) const;
+        // if key is already present, this returns the existing value instead
+        const Value& Insert(const Key& key, Value&& value,
+                            const std::uint64_t hash);
+
+        std::size_t size() const { return entries.size(); }
+
+    private:
+        struct Slot {
+            std::uint64_t hash;
+            std::size_t index; // position in entries plus 1; 0 means empty
+        };
+
+        std::vector<Slot> slots; // size is 0 or a power of 2
+        std::deque<std::pair<Key, Value>> entries;
+
+        void Grow();
+};
+
+template<typename Key, typename Value>
+inline const Value* FlatMap<Key, Value>::Find(const Key& key,
+                                              const std::uint64_t hash) const {
+    if (slots.empty()) return nullptr;
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hash & mask; slots[i].index != 0; i = (i+1) & mask) {
+        if (slots[i].hash == hash && entries[slots[i].index-1].first == key) {
+            return &entries[slots[i].index-1].second;
+        }
+    }
+    return nullptr;
+}
+
+template<typename Key, typename Value>
+inline const Value& FlatMap<Key, Value>::Insert(const Key& key, Value&& value,
+                                                const std::uint64_t hash) {
+    // keep the table at most half full so that probes stay short
+    if (2*(entries.size() + 1) > slots.size()) Grow();
+    const std::size_t mask = slots.size() - 1;
+    std::size_t i = hash & mask;
+    for (; slots[i].index != 0; i = (i+1) & mask) {
+        if (slots[i].hash == hash && entries[slots[i].index-1].first == key) {
+            return entries[slots[i].index-1].second;
+        }
+    }
+    entries.emplace_back(key, std::move(value));
+    slots[i] = {hash, entries.size()};
+    return entries.back().second;
+}
+
+template<typename Key, typename Value>
+inline void FlatMap<Key, Value>::Grow() {
+    std::vector<Slot> oldSlots(slots.empty() ? 16 : 2*slots.size(),
+                               Slot{0, 0});
+    oldSlots.swap(slots);
+    const std::size_t mask = slots.size() - 1;
+    for (const auto& slot : oldSlots) {
+        if (slot.index == 0) continue;
+        std::size_t i = slot.hash & mask;
+        while (slots[i].index != 0) i = (i+1) & mask;
+        slots[i] = slot;
+    }
+}
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>,
+         std::size_t Shards = 16>
+class ConcurrentCache {
+    public:
+        // return the value stored at key, first storing compute() there if
+        // the key isn't present yet
+        template<typename Compute>
+        const Value& Get(const Key& key, Compute&& compute);
+        // nullptr if key isn't present yet
+        const Value* Find(const Key& key) const;
+
+        std::size_t size() const;
+
+    private:
+        struct Shard {
+            mutable std::shared_timed_mutex mutex;
+            FlatMap<Key, Value> map;
+        };
+
+        std::array<Shard, Shards> shards;
+        Hash hasher;
+};
+
+template<typename Key, typename Value, typename Hash, std::size_t Shards>
+template<typename Compute>
+inline const Value& ConcurrentCache<Key, Value, Hash, Shards>::Get(
+        const Key& key, Compute&& compute) {
+    const std::uint64_t hash = MixHash(hasher(key));
+    // the low bits pick the slot within a shard, so use the high ones here
+    Shard& shard = shards[(hash >> 32) % Shards];
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+        const Value* found = shard.map.Find(key, hash);
+        if (found != nullptr) return *found;
+    }
+
+    Value value = compute();
+
+    std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+    // if another thread got here first, this leaves its value in place
+    return shard.map.Insert(key, std::move(value), hash);
+}
+
+template<typename Key, typename Value, typename Hash, std::size_t Shards>
+inline const Value* ConcurrentCache<Key, Value, Hash, Shards>::Find(
+        const Key& key) const {
+    const std::uint64_t hash = MixHash(hasher(key));
+    const Shard& shard = shards[(hash >> 32) % Shards];
+    std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+    return shard.map.Find(key, hash);
+}
+
+template<typename Key, typename Value, typename Hash, std::size_t Shards>
+inline std::size_t ConcurrentCache<Key, Value, Hash, Shards>::size() const {
+    std::size_t total = 0;
+    for (const auto& shard : shards) {
+        std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+        total += shard.map.size();
+    }
+    return total;
+}
+
+// Cache key made from a short string of small numbers such as an xAndy string,
+// packed into four machine words so that hashing and comparing it never touch
+// the heap. The last byte holds the length, so strings which only differ by
+// trailing zeros are still different keys.
+class PackedKey {
+    public:
+        static constexpr std::size_t CAPACITY = 31;
+
+        explicit PackedKey(const std::string& chars);
+
+        bool operator==(const PackedKey& other) const {
+            return words == other.words;
+        }
+        std::uint64_t Hash() const;
+
+    private:
+        std::array<std::uint64_t, 4> words;
+};
+
+struct PackedKeyHash {
+    std::uint64_t operator()(const PackedKey& key) const { return key.Hash(); }
+};
+
+inline PackedKey::PackedKey(const std::string& chars): words{{0, 0, 0, 0}} {
+    if (chars.size() > CAPACITY) {
+        throw std::length_error(__FILE__ ": asked to pack "
+                + std::to_string(chars.size()) + " chars into a key which only "
+                "holds " + std::to_string(CAPACITY));
+    }
+    unsigned char bytes[sizeof(words)] = {};
+    std::memcpy(bytes, chars.data(), chars.size());
+    bytes[CAPACITY] = chars.size();
+    std::memcpy(words.data(), bytes, sizeof(words));
+}
+
+inline std::uint64_t PackedKey::Hash() const {
+    std::uint64_t hash = words[0];
+    for (std::size_t i = 1; i < words.size(); ++i) {
+        hash = MixHash(hash) ^ words[i];
+    }
+    return hash;
+}
+
+#endif
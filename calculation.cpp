@@ -7,6 +7,10 @@ int Calculate(const Arguments& args) {
         return Test::RunAllTests(args);
     }
 
+    if (!args.cacheDir.empty()) ElementCache::Open(args.cacheDir);
+    if (args.interpolation > 0) InterpolateKernels(args.interpolation);
+    if (args.cubature > 0) IntegrateAdaptively(args.cubature);
+
     if (args.options & OPT_STATESONLY) {
         ComputeBasisStates(args);
         return EXIT_SUCCESS;
@@ -115,6 +119,11 @@ DMatrix ComputeHamiltonian(const Arguments& args) {
 
     *args.console << "\nEntire computation took " 
         << overallTimer.TimeElapsedInWords() << "." << endl;
+    const HypergeometricCounts stats = HypergeometricStats();
+    *args.console << "Hypergeometric series: " << stats.series << " summed "
+        << "and " << stats.continued << " continued toward x = 1, with " 
+        << stats.terms << " terms in all, plus " << stats.transformed 
+        << " 2F1s computed from series in 1-x." << endl;
 
     return DMatrix();
 }
@@ -146,7 +155,7 @@ Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
 
     int highestN = -1;
     std::unordered_map<int,Basis<Mono>> minBases;
-    std::unordered_map<int,SMatrix> discPolys;
+    std::unordered_map<int,DMatrix> polysOnMinBases;
 
     // do N=1 separately since it's trivial
     std::vector<Poly> nEqualsOne = NEqualsOneState();
@@ -168,18 +177,8 @@ Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
         minBases.emplace(n, MinimalBasis(orthogonalized));
         DMatrix polysOnMinBasis = PolysOnMinBasis(minBases.at(n), orthogonalized,
                                                   outStream);
+        polysOnMinBases.emplace(n, polysOnMinBasis);
 
-        if (n == 1) {
-            SMatrix disc(polysOnMinBasis.rows(), polysOnMinBasis.cols());
-            for (Eigen::Index row = 0; row < disc.rows(); ++row) {
-                for (Eigen::Index col = 0; col < disc.cols(); ++col) {
-                    disc.insert(row, col) = polysOnMinBasis(row, col);
-                }
-            }
-            discPolys.emplace(n, std::move(disc));
-        } else {
-            discPolys.emplace(n, DiscretizePolys(polysOnMinBasis, args.partitions));
-        }
         if (mathematica) {
             const std::string suffix = std::to_string(n) + parity;
             outStream << "minimalBasis[" << suffix << "] = "
@@ -188,9 +187,12 @@ Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
                 << "(*Polynomials on this basis (as rows, not columns!):*)\n"
                 << "polysOnMinBasis[" << suffix << "] = " 
                 << MathematicaOutput(polysOnMinBasis.transpose()) << endl;
+            // n=1 only has the one mu state
+            SMatrix discPolys = DiscretizePolys(polysOnMinBasis, 
+                                                n == 1 ? 1 : args.partitions);
             outStream << "(*And discretized:*)\ndiscretePolys[" << suffix 
                 << "] = " 
-                << MathematicaOutput(DMatrix(discPolys.at(n).transpose())) 
+                << MathematicaOutput(DMatrix(discPolys.transpose())) 
                 << endl;
         } else {
             outStream << "Minimal basis (" << n << "):" << minBases.at(n) 
@@ -199,21 +201,25 @@ Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
 
         args.numP = n;
         output.blocks.emplace(std::array<int,2>{n, n}, 
-                              DiagonalBlock(minBases.at(n), discPolys.at(n), 
-                                            args, odd));
+                              DiagonalBlock(minBases.at(n), 
+                                            polysOnMinBases.at(n), args, odd));
         if ((args.options & OPT_INTERACTING) != 0) {
-            if (discPolys.count(n-2) == 1) {
+            if (polysOnMinBases.count(n-2) == 1) {
                 args.numP = n;
                 output.blocks.emplace(std::array<int,2>{n-2, n},
-                                      NPlus2Block(minBases.at(n-2), discPolys.at(n-2),
-                                                  minBases.at(n), discPolys.at(n),
+                                      NPlus2Block(minBases.at(n-2), 
+                                                  polysOnMinBases.at(n-2),
+                                                  minBases.at(n), 
+                                                  polysOnMinBases.at(n),
                                                   args, odd));
             }
-            if (discPolys.count(n+2) == 1) {
+            if (polysOnMinBases.count(n+2) == 1) {
                 args.numP = n+2;
                 output.blocks.emplace(std::array<int,2>{n, n+2},
-                                      NPlus2Block(minBases.at(n), discPolys.at(n),
-                                                  minBases.at(n+2), discPolys.at(n+2),
+                                      NPlus2Block(minBases.at(n), 
+                                                  polysOnMinBases.at(n),
+                                                  minBases.at(n+2), 
+                                                  polysOnMinBases.at(n+2),
                                                   args, odd));
             }
         }
@@ -245,8 +251,12 @@ Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
     return output;
 }
 
+// the operators are computed as (Fock part) (x) (mu part), so the change to the
+// polynomial basis is only done to the Fock parts; this is the same as 
+// DiscretizePolys(polysOnMinBasis)^T * (mono matrix) * DiscretizePolys(...) 
+// without ever forming the (much larger) mono matrices
 DMatrix DiagonalBlock(const Basis<Mono>& minimalBasis, 
-                      const SMatrix& discPolys, 
+                      const DMatrix& polysOnMinBasis, 
                       const Arguments& args, const bool odd) {
     *args.console << "DiagonalBlock(" << args.numP << ", " << args.degree << ")" 
         << endl;
@@ -258,14 +268,16 @@ DMatrix DiagonalBlock(const Basis<Mono>& minimalBasis,
     std::size_t kMax = (args.numP == 1 ? 1 : args.partitions);
 
     timer.Start();
-    DMatrix monoMassMatrix(MassMatrix(minimalBasis, kMax));
-    DMatrix polyMassMatrix = discPolys.transpose()*monoMassMatrix*discPolys;
+    KroneckerSum monoMassMatrix(MassOperator(minimalBasis, kMax, args.threads));
+    DMatrix polyMassMatrix = monoMassMatrix.Project(polysOnMinBasis).Dense();
     OutputMatrix(monoMassMatrix, polyMassMatrix, "mass matrix", suffix, timer,
                  args);
 
     timer.Start();
-    DMatrix monoKineticMatrix(KineticMatrix(minimalBasis, kMax));
-    DMatrix polyKineticMatrix = discPolys.transpose()*monoKineticMatrix*discPolys;
+    KroneckerSum monoKineticMatrix(KineticOperator(minimalBasis, kMax, 
+                                                   args.threads));
+    DMatrix polyKineticMatrix 
+        = monoKineticMatrix.Project(polysOnMinBasis).Dense();
     OutputMatrix(monoKineticMatrix, polyKineticMatrix, "kinetic matrix", suffix,
                  timer, args);
 
@@ -273,8 +285,9 @@ DMatrix DiagonalBlock(const Basis<Mono>& minimalBasis,
                         + (args.cutoff*args.cutoff)*polyKineticMatrix;
     if (interacting) {
         timer.Start();
-        DMatrix monoNtoN(InteractionMatrix(minimalBasis, kMax));
-        DMatrix polyNtoN = discPolys.transpose()*monoNtoN*discPolys;
+        KroneckerSum monoNtoN(InteractionOperator(minimalBasis, kMax, 
+                                                  args.threads));
+        DMatrix polyNtoN = monoNtoN.Project(polysOnMinBasis).Dense();
         OutputMatrix(monoNtoN, polyNtoN, "NtoN matrix", suffix, timer, 
                      args);
         hamiltonian += (args.lambda*args.cutoff)*polyNtoN;
@@ -303,8 +316,8 @@ DMatrix DiagonalBlock(const Basis<Mono>& minimalBasis,
 }
 
 // basisA is the minBasis of degree n, while basisB is the one for degree n+2
-DMatrix NPlus2Block(const Basis<Mono>& basisA, const SMatrix& discPolysA,
-                    const Basis<Mono>& basisB, const SMatrix& discPolysB,
+DMatrix NPlus2Block(const Basis<Mono>& basisA, const DMatrix& polysOnMinBasisA,
+                    const Basis<Mono>& basisB, const DMatrix& polysOnMinBasisB,
                     const Arguments& args, const bool odd) {
     *args.console << "NPlus2Block(" << args.numP-2 << " -> " << args.numP << ")" 
         << endl;
@@ -315,8 +328,10 @@ DMatrix NPlus2Block(const Basis<Mono>& basisA, const SMatrix& discPolysA,
                        + (odd ? ", odd" : ", even");
 
     timer.Start();
-    DMatrix monoNPlus2(NPlus2Matrix(basisA, basisB, args.partitions));
-    DMatrix polyNPlus2 = discPolysA.transpose()*monoNPlus2*discPolysB;
+    KroneckerSum monoNPlus2(NPlus2Operator(basisA, basisB, args.partitions, 
+                                           args.threads));
+    DMatrix polyNPlus2 = monoNPlus2.Project(polysOnMinBasisA, 
+                                            polysOnMinBasisB).Dense();
     OutputMatrix(monoNPlus2, polyNPlus2, "NPlus2 matrix", suffix, timer, args);
 
     return (args.lambda*args.cutoff) * polyNPlus2;
@@ -413,7 +428,8 @@ void AnalyzeHamiltonian_Sparse(const Hamiltonian& hamiltonian,
     }
 }
 
-void OutputMatrix(const DMatrix& monoMatrix, const DMatrix& polyMatrix,
+// the mono matrix is only made dense if it's actually going to be printed
+void OutputMatrix(const KroneckerSum& monoMatrix, const DMatrix& polyMatrix,
                   std::string name, const std::string& suffix, Timer& timer, 
                   const Arguments& args) {
     OStream& outStream = *args.outStream;
@@ -426,7 +442,7 @@ void OutputMatrix(const DMatrix& monoMatrix, const DMatrix& polyMatrix,
         name[0] = std::toupper(name[0]);
         if (full) {
             outStream << "minBasis" << mathematicaName << "[" << suffix <<"] = "
-                << MathematicaOutput(monoMatrix) << '\n';
+                << MathematicaOutput(monoMatrix.Dense()) << '\n';
         }
         outStream << "basisState" << mathematicaName << "[" << suffix << "] = "
             << MathematicaOutput(polyMatrix) << '\n';
@@ -440,7 +456,7 @@ void OutputMatrix(const DMatrix& monoMatrix, const DMatrix& polyMatrix,
     } else if (polyMatrix.rows() <= 10 && polyMatrix.cols() <= 10) {
         outStream << "Computed a " << name << " for the basis in " 
             << timer.TimeElapsedInWords() << "; ";
-        if (full) outStream << "mono:\n" << monoMatrix << '\n';
+        if (full) outStream << "mono:\n" << monoMatrix.Dense() << '\n';
         outStream << "poly:\n" << polyMatrix << '\n';
     } else if (polyMatrix.rows() == polyMatrix.cols()) {
         DEigenSolver solver(polyMatrix.cast<builtin_class>());
@@ -43,10 +43,10 @@ DMatrix ComputeHamiltonian(const Arguments& args);
 Hamiltonian FullHamiltonian(const boost::filesystem::path& basisDir,
                             Arguments args, const bool odd);
 DMatrix DiagonalBlock(const Basis<Mono>& minimalBasis, 
-                      const SMatrix& discPolys, 
+                      const DMatrix& polysOnMinBasis, 
                       const Arguments& args, const bool odd);
-DMatrix NPlus2Block(const Basis<Mono>& basisA, const SMatrix& discPolysA,
-                    const Basis<Mono>& basisB, const SMatrix& discPolysB,
+DMatrix NPlus2Block(const Basis<Mono>& basisA, const DMatrix& polysOnMinBasisA,
+                    const Basis<Mono>& basisB, const DMatrix& polysOnMinBasisB,
                     const Arguments& args, const bool odd);
 
 void AnalyzeHamiltonian(const Hamiltonian& hamiltonian, const Arguments& args,
@@ -58,7 +58,7 @@ void AnalyzeHamiltonian_Sparse(const Hamiltonian& hamiltonian,
 
 // stuff for printing results -------------------------------------------------
 
-void OutputMatrix(const DMatrix& monoMatrix, const DMatrix& polyMatrix,
+void OutputMatrix(const KroneckerSum& monoMatrix, const DMatrix& polyMatrix,
                   std::string name, const std::string& suffix, Timer& timer, 
                   const Arguments& args);
 std::string MathematicaName(std::string name);
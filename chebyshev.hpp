@@ -0,0 +1,143 @@
+#ifndef CHEBYSHEV_HPP
+#define CHEBYSHEV_HPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm> // std::upper_bound
+#include <functional> // std::function
+#include <stdexcept>
+
+#include "constants.hpp"
+
+// Piecewise Chebyshev interpolant of a smooth function of x in [0, 1), for the
+// kernels of the MuPart corners, which are needed at every ratio x = mu1/mu2 of
+// the partition edges but only depend on x through a few hypergeometric
+// functions with fixed parameters.
+//
+// The kernels usually have a logarithmic singularity at x = 1, so the interval
+// is first cut into pieces [1 - 2^-m, 1 - 2^-(m+1)] whose widths shrink along
+// with their distance from the singularity, and each of these is bisected (a
+// few times at most) until the last two Chebyshev coefficients on every piece
+// are within the tolerance, relative to the largest value on the piece. Since
+// the function is smooth on each of these pieces, a piece which still isn't
+// within the tolerance after that is limited by noise in the function values
+// rather than by the degree, and the noise only gets worse closer to x = 1, so
+// the grading stops there. Arguments above the last piece, or in a piece which
+// couldn't be brought within the tolerance, aren't covered: the interpolant 
+// returns NaN there, and they have to be evaluated directly.
+
+class PiecewiseChebyshev {
+    public:
+        // the function to approximate takes a batch of arguments, so that all
+        // of the nodes of a piece can be evaluated at once
+        typedef std::function<std::vector<coeff_class>(
+                const std::vector<builtin_class>&)> Function;
+
+        // Chebyshev coefficients per piece, so each evaluation is this long
+        static constexpr std::size_t DEGREE = 20;
+        // pieces are graded down to this distance from x = 1
+        static constexpr int GRADING_LEVELS = 10;
+        // each graded piece is bisected at most this many times over
+        static constexpr int MAX_SPLITS = 2;
+
+        PiecewiseChebyshev(const Function& function,
+                           const builtin_class tolerance);
+
+        // NaN if x isn't covered by any piece
+        coeff_class operator()(const builtin_class x) const;
+
+        std::size_t Pieces() const { return lowers.size(); }
+
+    private:
+        struct Piece {
+            builtin_class upper;
+            std::vector<coeff_class> coefficients;
+        };
+
+        // both sorted by lower edge; lowers is kept separately for searching
+        std::vector<builtin_class> lowers;
+        std::vector<Piece> pieces;
+
+        // true if all of [lower, upper] ended up covered
+        bool Fit(const Function& function, const builtin_class tolerance,
+                 const builtin_class lower, const builtin_class upper,
+                 const int splits);
+};
+
+inline PiecewiseChebyshev::PiecewiseChebyshev(const Function& function,
+                                              const builtin_class tolerance) {
+    if (!(tolerance > 0)) {
+        throw std::invalid_argument(__FILE__ ": PiecewiseChebyshev needs a "
+                                    "positive tolerance");
+    }
+    builtin_class lower = 0;
+    builtin_class width = 0.5;
+    for (int level = 0; level < GRADING_LEVELS; ++level) {
+        if (!Fit(function, tolerance, lower, lower + width, MAX_SPLITS)) break;
+        lower += width;
+        width /= 2;
+    }
+}
+
+inline bool PiecewiseChebyshev::Fit(const Function& function,
+                                    const builtin_class tolerance,
+                                    const builtin_class lower,
+                                    const builtin_class upper,
+                                    const int splits) {
+    constexpr std::size_t N = DEGREE;
+    std::vector<builtin_class> nodes(N);
+    for (std::size_t j = 0; j < N; ++j) {
+        builtin_class t = std::cos(M_PI * (j + 0.5) / N);
+        nodes[j] = (lower + upper)/2 + t*(upper - lower)/2;
+    }
+    std::vector<coeff_class> values = function(nodes);
+
+    coeff_class scale = 0;
+    bool finite = true;
+    for (const coeff_class& value : values) {
+        finite &= std::isfinite(static_cast<builtin_class>(value));
+        scale = std::max<coeff_class>(scale, value < 0 ? -value : value);
+    }
+
+    std::vector<coeff_class> coefficients(N, 0);
+    for (std::size_t k = 0; k < N && finite; ++k) {
+        for (std::size_t j = 0; j < N; ++j) {
+            coefficients[k] += values[j] * std::cos(M_PI * k * (j + 0.5) / N);
+        }
+        coefficients[k] *= (k == 0 ? 1.0 : 2.0) / N;
+    }
+
+    coeff_class tail = std::abs(static_cast<builtin_class>(coefficients[N-1]))
+                     + std::abs(static_cast<builtin_class>(coefficients[N-2]));
+    if (finite && tail <= tolerance*scale) {
+        lowers.push_back(lower);
+        pieces.push_back({upper, std::move(coefficients)});
+        return true;
+    } else if (splits > 0) {
+        builtin_class middle = (lower + upper) / 2;
+        bool covered = Fit(function, tolerance, lower, middle, splits - 1);
+        return Fit(function, tolerance, middle, upper, splits - 1) && covered;
+    }
+    return false;
+}
+
+// Clenshaw's recurrence on the piece containing x
+inline coeff_class PiecewiseChebyshev::operator()(const builtin_class x) const {
+    auto after = std::upper_bound(lowers.begin(), lowers.end(), x);
+    if (after == lowers.begin()) return std::nan("");
+    const Piece& piece = pieces[after - lowers.begin() - 1];
+    const builtin_class lower = *(after - 1);
+    if (x > piece.upper) return std::nan("");
+
+    coeff_class t = (2*x - lower - piece.upper) / (piece.upper - lower);
+    coeff_class b1 = 0;
+    coeff_class b2 = 0;
+    for (std::size_t k = DEGREE - 1; k > 0; --k) {
+        coeff_class b0 = 2*t*b1 - b2 + piece.coefficients[k];
+        b2 = b1;
+        b1 = b0;
+    }
+    return t*b1 - b2 + piece.coefficients[0];
+}
+
+#endif
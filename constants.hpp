@@ -119,7 +119,11 @@ struct Arguments {
     coeff_class lambda = 1; // the coefficient of the interaction term
     coeff_class cutoff = 1; // the energy cutoff (capital lambda)
     int options = 0;
+    unsigned int threads = MAX_THREADS; // threads used to fill matrices
+    double interpolation = 0; // tolerance of the mu kernel fits; 0 for none
+    double cubature = 0; // tolerance of adaptive mu window integrals; 0 for none
     std::string basisDir = ""; // location of dir containing orthogonal vectors
+    std::string cacheDir = ""; // dir of stored matrix elements; "" for none
     OStream* outStream = nullptr;
     OStream* console = nullptr;
 };
@@ -160,8 +164,28 @@ constexpr coeff_class Pochhammer(const coeff_class A, const int n) {
     return ret;
 }
 
+// factorials up to this are tabulated when compiling; they're all exact in 
+// __float128, whose 113-bit significand is enough for the odd part of 34!
+constexpr int FACTORIAL_TABLE_SIZE = 35;
+
+struct FactorialTable {
+    coeff_class values[FACTORIAL_TABLE_SIZE];
+};
+
+constexpr FactorialTable MakeFactorialTable() {
+    FactorialTable table{};
+    table.values[0] = 1;
+    for (int n = 1; n < FACTORIAL_TABLE_SIZE; ++n) {
+        table.values[n] = n*table.values[n-1];
+    }
+    return table;
+}
+
+constexpr FactorialTable FACTORIALS = MakeFactorialTable();
+
 constexpr coeff_class Factorial(const int n) {
-    return Pochhammer(1, n);
+    return n >= 0 && n < FACTORIAL_TABLE_SIZE ? FACTORIALS.values[n] 
+                                              : Pochhammer(1, n);
 }
 
 // this would be constexpr instead of inline if the cmath functions were 
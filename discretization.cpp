@@ -1,6 +1,8 @@
 #include "discretization.hpp"
 
-constexpr std::size_t INTEGRAL_SAMPLES = 100;
+// nodes per dimension of the Gauss-Jacobi rules for the windows which have to
+// be integrated numerically
+constexpr std::size_t QUADRATURE_NODES = 16;
 
 // Take a non-discretized polysOnMinBasis matrix and return one that expresses
 // the k'th slice of each polynomial in terms of the k'th slices of its 
@@ -82,62 +84,401 @@ DMatrix MuPart_1(const MATRIX_TYPE type) {
 
 // n->n interaction -----------------------------------------------------------
 
-// before transformation, first exponent is that of alpha, and the second is 
-// that of r; afterward, the first is the exponent of sqrt(alpha), and the
-// second is the exponent of r
-const DMatrix& MuPart_NtoN(const unsigned int n,
-                           std::array<char,2> exponents, 
-                           const std::size_t partitions) {
-    static std::unordered_map<std::array<char,2>, DMatrix, 
-                              boost::hash<std::array<char,2>> > cache;
+namespace {
+
+// the MuPart_NtoN and MuPart_NPlus2 tables are cached by (n, exponents,
+// partitions) packed into one word, so tables for different kMax (e.g. from
+// one GUI session) never get mixed up
+std::uint64_t MuPartKey(const unsigned int n, const char exponent0,
+                        const char exponent1, const std::size_t partitions) {
+    return (std::uint64_t(n) << 48)
+        | (std::uint64_t(static_cast<unsigned char>(exponent0)) << 40)
+        | (std::uint64_t(static_cast<unsigned char>(exponent1)) << 32)
+        | (partitions & 0xFFFFFFFF);
+}
 
-    if (n == 1) {
-        static std::unique_ptr<DMatrix> matrix11;
+ConcurrentCache<std::uint64_t, DMatrix> ntonCache;
+ConcurrentCache<std::uint64_t, DMatrix> nPlus2Cache;
+
+// Each corner of a Less window is a power of mu1 and mu2 times a kernel which
+// only depends on x = mu1/mu2 and the (transformed) exponents. The kernels are
+// evaluated directly unless InterpolateKernels has been given a tolerance, in
+// which case they come from an interpolant built once per set of exponents.
+builtin_class kernelTolerance = 0;
+
+// relative tolerance of the adaptive cubature for the windows which have to be
+// integrated numerically, if IntegrateAdaptively has been given one; otherwise
+// they use fixed Gauss-Jacobi rules
+builtin_class cubatureTolerance = 0;
+
+// the value of an adaptive cubature, with a warning if it ran out of 
+// evaluations before reaching the tolerance
+coeff_class CubatureValue(const CubatureResult& result, const char* window) {
+    builtin_class value = static_cast<builtin_class>(result.value);
+    builtin_class error = static_cast<builtin_class>(result.error);
+    if (error > cubatureTolerance*std::abs(value)) {
+        std::cerr << "Warning: " << window << " could only be integrated to a "
+            << "relative error of " << error/std::abs(value) << "." << std::endl;
+    }
+    return result.value;
+}
+
+typedef ConcurrentCache<std::array<char,2>, PiecewiseChebyshev,
+                        boost::hash<std::array<char,2>>> InterpolantCache;
+InterpolantCache ntonKernels;
+InterpolantCache nPlus2Kernels;
 
-        if (matrix11 == nullptr) {
-            matrix11 = std::make_unique<DMatrix>(DMatrix::Zero(1, 1));
+std::vector<coeff_class> NtoNKernel_Direct(const std::array<char,2>& exponents,
+                                           const std::vector<builtin_class>& x) {
+    const builtin_class r = exponents[1]; // exponent of r (not r^2)
+    std::vector<coeff_class> output(x.size());
+    if (exponents[0] == 2) {
+        // these are all unregularized, hence the gamma functions
+        std::vector<coeff_class> hg2F1, hg3F2_15, hg3F2_25, hg4F3;
+        HypergeometricPFQ_Reg_Batch<2,1>({{1.5, 0.5 + r/2.0}}, 
+                                         {{1.0 + r/2.0}}, x, hg2F1);
+        HypergeometricPFQ_Reg_Batch<3,2>({{1.5, 2.5, 1.5 + r/2.0}}, 
+                                         {{3.5, 2.0 + r/2.0}}, x, hg3F2_15);
+        HypergeometricPFQ_Reg_Batch<3,2>({{2.5, 2.5, 1.5 + r/2.0}}, 
+                                         {{3.5, 2.0 + r/2.0}}, x, hg3F2_25);
+        HypergeometricPFQ_Reg_Batch<4,3>({{1.0, 1.0, 2.5, 1.5 + r/2.0}}, 
+                                         {{2.0, 2.0, 2.0 + r/2.0}}, x, hg4F3);
+        coeff_class gamma2F1 = std::tgamma(1.0 + r/2.0);
+        coeff_class gamma3F2 = std::tgamma(3.5) * std::tgamma(2.0 + r/2.0);
+        coeff_class gamma4F3 = std::tgamma(2.0 + r/2.0);
+
+        for (std::size_t j = 0; j < x.size(); ++j) {
+            output[j] = (8.0 * (r+2.0)) / (9.0 * (r+1.0)) * hg2F1[j] * gamma2F1;
+            output[j] -= (2.0 * x[j]) / 5.0 * hg3F2_15[j] * gamma3F2;
+            output[j] -= (8.0 * x[j]) / 15.0 * hg3F2_25[j] * gamma3F2;
+            output[j] -= (0.5 * x[j]) * hg4F3[j] * gamma4F3;
         }
+        return output;
+    }
 
-        return *matrix11;
+    const builtin_class a = exponents[0]/2.0; // exponent of alpha (not alpha^2)
+    std::vector<coeff_class> hgPlus, hgMinus;
+    HypergeometricPFQ_Reg_Batch<3,2>({{0.5, 0.5 + r/2.0, (a+2.0)/2.0}},
+                                     {{r/2.0 + 1.0, (a+2.0)/2.0 + 1.0}}, 
+                                     x, hgPlus);
+    HypergeometricPFQ_Reg_Batch<3,2>({{0.5, 0.5 + r/2.0, (a-1.0)/2.0}},
+                                     {{r/2.0 + 1.0, (a-1.0)/2.0 + 1.0}}, 
+                                     x, hgMinus);
+    coeff_class gammaPlus = std::tgamma((a+2.0)/2.0);
+    coeff_class gammaMinus = std::tgamma((a-1.0)/2.0);
+    for (std::size_t j = 0; j < x.size(); ++j) {
+        output[j] = gammaPlus*hgPlus[j] - gammaMinus*hgMinus[j];
     }
+    return output;
+}
 
-    if (n == 2) {
-        static std::unique_ptr<DMatrix> matrix22;
+std::vector<coeff_class> NPlus2Kernel_Direct(const std::array<char,2>& nr,
+                                        const std::vector<builtin_class>& x) {
+    const builtin_class n = nr[0];
+    const builtin_class a = 0.5 * nr[1];
+    // these are unregularized, hence the gamma functions
+    std::vector<coeff_class> hgPlus, hgMinus;
+    HypergeometricPFQ_Reg_Batch<2,1>({{-a, (n+1.0)/4.0}}, {{(n+5.0)/4.0}}, 
+                                     x, hgPlus);
+    HypergeometricPFQ_Reg_Batch<2,1>({{-a, (n-5.0)/4.0}}, {{(n-1.0)/4.0}}, 
+                                     x, hgMinus);
+    coeff_class gammaPlus = std::tgamma((n+5.0)/4.0);
+    coeff_class gammaMinus = std::tgamma((n-1.0)/4.0);
+
+    std::vector<coeff_class> output(x.size());
+    for (std::size_t j = 0; j < x.size(); ++j) {
+        output[j]  = hgPlus[j] * gammaPlus / (n + 1.0);
+        output[j] -= hgMinus[j] * gammaMinus / (n - 5.0);
+    }
+    return output;
+}
 
-        if (matrix22 == nullptr) {
-            matrix22 = MuPart_2to2(partitions);
-            *matrix22 *= GKNorm(partitions);
+const PiecewiseChebyshev& NtoNInterpolant(const std::array<char,2>& exponents) {
+    return ntonKernels.Get(exponents, [&exponents]() {
+            return PiecewiseChebyshev(
+                [exponents](const std::vector<builtin_class>& x) {
+                    return NtoNKernel_Direct(exponents, x);
+                }, kernelTolerance);
+        });
+}
+
+const PiecewiseChebyshev& NPlus2Interpolant(const std::array<char,2>& nr) {
+    return nPlus2Kernels.Get(nr, [&nr]() {
+            return PiecewiseChebyshev(
+                [nr](const std::vector<builtin_class>& x) {
+                    return NPlus2Kernel_Direct(nr, x);
+                }, kernelTolerance);
+        });
+}
+
+// the kernel at every x, taken from the interpolant wherever it covers x and
+// evaluated directly (all together) everywhere else
+std::vector<coeff_class> Kernel(const PiecewiseChebyshev& interpolant,
+                                const PiecewiseChebyshev::Function& direct,
+                                const std::vector<builtin_class>& x) {
+    std::vector<coeff_class> output(x.size());
+    std::vector<std::size_t> uncovered;
+    std::vector<builtin_class> uncoveredX;
+    for (std::size_t j = 0; j < x.size(); ++j) {
+        output[j] = interpolant(x[j]);
+        if (std::isnan(static_cast<builtin_class>(output[j]))) {
+            uncovered.push_back(j);
+            uncoveredX.push_back(x[j]);
         }
+    }
+    if (uncovered.empty()) return output;
 
-        return *matrix22;
+    std::vector<coeff_class> values = direct(uncoveredX);
+    for (std::size_t k = 0; k < uncovered.size(); ++k) {
+        output[uncovered[k]] = values[k];
     }
+    return output;
+}
 
-    exponents[0] = 2*exponents[0] + n - 3;
-    exponents[1] = exponents[1] + n - 3;
+std::vector<coeff_class> NtoNKernel(const std::array<char,2>& exponents,
+                                    const std::vector<builtin_class>& x) {
+    if (kernelTolerance <= 0) return NtoNKernel_Direct(exponents, x);
+    return Kernel(NtoNInterpolant(exponents), 
+                  [&exponents](const std::vector<builtin_class>& x) {
+                      return NtoNKernel_Direct(exponents, x);
+                  }, x);
+}
+
+std::vector<coeff_class> NPlus2Kernel(const std::array<char,2>& nr,
+                                      const std::vector<builtin_class>& x) {
+    if (kernelTolerance <= 0) return NPlus2Kernel_Direct(nr, x);
+    return Kernel(NPlus2Interpolant(nr), 
+                  [&nr](const std::vector<builtin_class>& x) {
+                      return NPlus2Kernel_Direct(nr, x);
+                  }, x);
+}
+
+// before transformation, first exponent is that of alpha, and the second is 
+// that of r; afterward, the first is the exponent of sqrt(alpha), and the
+// second is the exponent of r
+std::array<char,2> NtoNExponents(const unsigned int n,
+                                 const std::array<char,2>& exponents) {
+    return {{static_cast<char>(2*exponents[0] + n - 3),
+             static_cast<char>(exponents[1] + n - 3)}};
+}
+
+// Every Less window's corners lie on the grid of partition edges, and each
+// corner is shared by up to four windows, so a table's corners are evaluated
+// once each into grid(i, j), the corner at edges (i, j), before any windows are
+// put together. The windows only need rows i < partitions of the grid, with 
+// j >= i; grids are partitions x (partitions+1), and their rows don't depend 
+// on each other, so they can be done by different threads.
+void NtoNCornerRow(DMatrix& grid, const std::array<char,2>& exponents,
+                   const std::size_t i) {
+    const std::size_t partitions = grid.rows();
+    builtin_class partWidth = builtin_class(1) / partitions;
+    // the special case integrates adjacent windows numerically instead of 
+    // using their corners, so it doesn't need any corners with i == j
+    std::size_t start = std::max<std::size_t>(exponents[0] == 2 ? i+1 : i, 1);
+    if (start > partitions) return;
+    std::vector<builtin_class> mu2(partitions + 1 - start);
+    for (std::size_t j = start; j <= partitions; ++j) {
+        mu2[j - start] = j*partWidth;
+    }
+    std::vector<coeff_class> corners = NtoNCorners_Less(exponents, i*partWidth,
+                                                        mu2);
+    for (std::size_t j = start; j <= partitions; ++j) {
+        grid(i, j) = corners[j - start];
+    }
+}
 
+void NPlus2CornerRow(DMatrix& grid, const std::array<char,2>& nr,
+                     const std::size_t i) {
+    // n=5 is integrated numerically instead
+    if (nr[0] == 5) return;
+    const std::size_t partitions = grid.rows();
+    coeff_class partWidth = coeff_class(1) / partitions;
+    std::size_t start = std::max<std::size_t>(i, 1);
+    std::vector<builtin_class> mu2(partitions + 1 - start);
+    for (std::size_t j = start; j <= partitions; ++j) {
+        mu2[j - start] = static_cast<builtin_class>(j*partWidth);
+    }
+    std::vector<coeff_class> corners = NPlus2Corners_Less(nr[0], nr[1], 
+            static_cast<builtin_class>(i*partWidth), mu2);
+    for (std::size_t j = start; j <= partitions; ++j) {
+        grid(i, j) = corners[j - start];
+    }
+}
+
+std::array<coeff_class,4> WindowCorners(const DMatrix& grid, 
+                                        const std::size_t winA,
+                                        const std::size_t winB) {
+    return {{grid(winA, winB), grid(winA, winB+1), 
+             grid(winA+1, winB), grid(winA+1, winB+1)}};
+}
+
+// fill row winA of an n>=3 MuPart_NtoN table (before the g_k normalization),
+// given the transformed exponents and the filled grid of corners; like the
+// corner rows, these can be done by different threads
+void NtoNRow(DMatrix& block, const DMatrix& grid, 
+             const std::array<char,2>& exponents, const std::size_t winA) {
+    const std::size_t partitions = block.rows();
     builtin_class partWidth = builtin_class(1) / partitions;
-    if (cache.count(exponents) == 0) {
+    block(winA, winA) = NtoNWindow_Equal(exponents,
+                                         {{winA*partWidth, 
+                                           (winA+1)*partWidth}} );
+    for (std::size_t winB = winA+1; winB < partitions; ++winB) {
+        std::array<builtin_class,2> mu1sq_ab{{winA*partWidth, 
+                                              (winA+1)*partWidth}};
+        std::array<builtin_class,2> mu2sq_ab{{winB*partWidth, 
+                                              (winB+1)*partWidth}};
+        block(winA, winB) = NtoNWindow_Less(exponents, mu1sq_ab, mu2sq_ab,
+                                            WindowCorners(grid, winA, winB));
+        // block(winB, winA) = block(winA, winB);
+    }
+}
+
+// fill row winA of an n>=3 MuPart_NPlus2 table, as with NtoNRow
+void NPlus2Row(DMatrix& block, const DMatrix& grid, 
+               const std::array<char,2>& nr, const std::size_t winA) {
+    const std::size_t partitions = block.rows();
+    coeff_class partWidth = coeff_class(1) / partitions;
+    // entry is 0 when alpha > 1, so winB >= winA; 
+    // when winB == winA, we need to use a special answer as well
+    // because only half of the triangle is included
+    block(winA, winA) = NPlus2Window_Equal(nr[0], nr[1], 
+                                           winA*partWidth, 
+                                           (winA+1)*partWidth);
+    for (std::size_t winB = winA+1; winB < partitions; ++winB) {
+        block(winA, winB) = NPlus2Window_Less(nr[0], nr[1], 
+                {{static_cast<builtin_class>(winA*partWidth),
+                static_cast<builtin_class>((winA+1)*partWidth)}},
+                {{static_cast<builtin_class>(winB*partWidth), 
+                static_cast<builtin_class>((winB+1)*partWidth)}},
+                WindowCorners(grid, winA, winB));
+    }
+}
+
+// n=1 only has one state and no g_k norm (n=3 half still has one)
+DMatrix NPlus2Table_1(const std::size_t partitions) {
+    DMatrix block(1, partitions);
+    for (std::size_t win = 0; win < partitions; ++win) {
+        block(0, win) = (std::sqrt(win+1) - std::sqrt(win)) / M_PI;
+    }
+    return block;
+}
+
+} // anonymous namespace
+
+// from now on, take the kernels of the Less corners from piecewise Chebyshev
+// interpolants in x which are accurate to the given relative tolerance; this 
+// should be called before any MuPart tables are made, and 0 turns it off
+void InterpolateKernels(const builtin_class tolerance) {
+    // the series behind the kernels stop at PRECISION_LIMIT, so their values
+    // are too noisy to fit any more closely than this
+    const builtin_class floor = 10*static_cast<builtin_class>(PRECISION_LIMIT);
+    if (tolerance > 0 && tolerance < floor) {
+        std::cerr << "Warning: kernel interpolation tolerance " << tolerance 
+            << " is below the precision of the hypergeometric series; using "
+            << floor << " instead." << std::endl;
+        kernelTolerance = floor;
+    } else {
+        kernelTolerance = tolerance;
+    }
+}
+
+// from now on, integrate the windows which have no analytic form with an
+// adaptive cubature to the given relative tolerance instead of fixed rules; 
+// this should be called before any MuPart tables are made, and 0 turns it off
+void IntegrateAdaptively(const builtin_class tolerance) {
+    cubatureTolerance = tolerance;
+}
+
+// exponents are those of alpha and r in the matrix element; the table is 
+// computed the first time each (n, exponents, partitions) is asked for, unless
+// PrecomputeMuPart_NtoN has already done it
+const DMatrix& MuPart_NtoN(const unsigned int n,
+                           std::array<char,2> exponents, 
+                           const std::size_t partitions) {
+    if (n == 1) {
+        // function-local statics are initialized exactly once even if several
+        // threads get here at the same time
+        static const DMatrix matrix11 = DMatrix::Zero(1, 1);
+
+        return matrix11;
+    }
+
+    // the n=2 table doesn't depend on the exponents at all
+    if (n == 2) exponents = {{0, 0}};
+
+    std::uint64_t key = MuPartKey(n, exponents[0], exponents[1], partitions);
+    return ntonCache.Get(key, [n, &exponents, partitions]() {
+        if (n == 2) {
+            std::unique_ptr<DMatrix> matrix = MuPart_2to2(partitions);
+            *matrix *= GKNorm(partitions);
+            return *matrix;
+        }
+
+        std::array<char,2> transformed = NtoNExponents(n, exponents);
+        DMatrix grid = DMatrix::Zero(partitions, partitions+1);
+        for (std::size_t i = 0; i < partitions; ++i) {
+            NtoNCornerRow(grid, transformed, i);
+        }
         DMatrix block = DMatrix::Zero(partitions, partitions);
         for (std::size_t winA = 0; winA < partitions; ++winA) {
-            block(winA, winA) = NtoNWindow_Equal(exponents,
-                                                 {{winA*partWidth, 
-                                                   (winA+1)*partWidth}} );
-            for (std::size_t winB = winA+1; winB < partitions; ++winB) {
-                std::array<builtin_class,2> mu1sq_ab{{winA*partWidth, 
-                                                      (winA+1)*partWidth}};
-                std::array<builtin_class,2> mu2sq_ab{{winB*partWidth, 
-                                                      (winB+1)*partWidth}};
-                block(winA, winB) = NtoNWindow_Less(exponents, mu1sq_ab,
-                                                    mu2sq_ab);
-                // block(winB, winA) = block(winA, winB);
-            }
+            NtoNRow(block, grid, transformed, winA);
         }
         // this is from the normalization of the g_k
         block *= GKNorm(partitions);
-        cache.emplace(exponents, std::move(block));
+        return block;
+    });
+}
+
+// compute the MuPart_NtoN tables for all of the given exponents which aren't
+// cached yet, spreading all of their rows over the given number of threads
+void PrecomputeMuPart_NtoN(const unsigned int n, 
+                           const std::vector<std::array<char,2>>& exponents,
+                           const std::size_t partitions, 
+                           const unsigned int threads) {
+    if (n <= 2) {
+        // these are a single closed-form table each, so there's nothing to 
+        // spread out
+        if (!exponents.empty()) MuPart_NtoN(n, exponents.front(), partitions);
+        return;
+    }
+
+    std::vector<std::array<char,2>> missing;
+    std::unordered_set<std::uint64_t> missingKeys;
+    for (const auto& e : exponents) {
+        std::uint64_t key = MuPartKey(n, e[0], e[1], partitions);
+        if (ntonCache.Find(key) == nullptr && missingKeys.insert(key).second) {
+            missing.push_back(e);
+        }
     }
 
-    return cache[exponents];
+    std::vector<std::array<char,2>> transformed;
+    for (const auto& e : missing) transformed.push_back(NtoNExponents(n, e));
+    // the interpolants are shared by all of a table's rows, so they're built 
+    // first rather than by whichever threads happen to need them at once
+    if (kernelTolerance > 0) {
+        FillRows(transformed.size(), threads, [&](const std::size_t i) {
+            NtoNInterpolant(transformed[i]);
+        });
+    }
+    // all of the corners have to be done before any of the windows
+    std::vector<DMatrix> grids(missing.size(), 
+                               DMatrix::Zero(partitions, partitions+1));
+    FillRows(missing.size()*partitions, threads, [&](const std::size_t i) {
+        NtoNCornerRow(grids[i / partitions], transformed[i / partitions], 
+                      i % partitions);
+    });
+    std::vector<DMatrix> blocks(missing.size(), 
+                                DMatrix::Zero(partitions, partitions));
+    FillRows(missing.size()*partitions, threads, [&](const std::size_t i) {
+        NtoNRow(blocks[i / partitions], grids[i / partitions], 
+                transformed[i / partitions], i % partitions);
+    });
+
+    for (std::size_t k = 0; k < missing.size(); ++k) {
+        blocks[k] *= GKNorm(partitions);
+        ntonCache.Get(MuPartKey(n, missing[k][0], missing[k][1], partitions),
+                      [&blocks, k]() { return std::move(blocks[k]); });
+    }
 }
 
 std::unique_ptr<DMatrix> MuPart_2to2(const std::size_t partitions) {
@@ -167,38 +508,42 @@ std::unique_ptr<DMatrix> MuPart_2to2(const std::size_t partitions) {
     return output;
 }
 
+// The Less windows are integrals whose antiderivatives are known in closed
+// form, so each window is the signed sum of the antiderivative (the "corner"
+// functions below) at its four corners. Each of these versions computes the
+// corners itself; the table builders above evaluate every corner on the grid
+// of partition edges just once, since neighbouring windows share them, and 
+// pass them in as {(a,a), (a,b), (b,a), (b,b)} for mu1_ab x mu2_ab.
 coeff_class NtoNWindow_Less(const std::array<char,2>& exponents,
                             const std::array<builtin_class,2>& mu1sq_ab,
                             const std::array<builtin_class,2>& mu2sq_ab) {
+    std::array<coeff_class,4> corners{};
+    if (exponents[0] != 2 || mu1sq_ab[1] != mu2sq_ab[0]) {
+        for (std::size_t i = 0; i < 2; ++i) {
+            for (std::size_t j = 0; j < 2; ++j) {
+                corners[2*i + j] = NtoNCorner_Less(exponents, mu1sq_ab[i], 
+                                                   mu2sq_ab[j]);
+            }
+        }
+    }
+    return NtoNWindow_Less(exponents, mu1sq_ab, mu2sq_ab, corners);
+}
+
+coeff_class NtoNWindow_Less(const std::array<char,2>& exponents,
+                            const std::array<builtin_class,2>& mu1sq_ab,
+                            const std::array<builtin_class,2>& mu2sq_ab,
+                            const std::array<coeff_class,4>& corners) {
     // if exponents[0] == 2, there's a 0/0 limit that must be done separately
     if (exponents[0] == 2) {
         // I wonder if there's a way to do this as an NtoNWindow_Greater instead
-        return NtoNWindow_Less_Special(exponents[1], mu1sq_ab, mu2sq_ab);
+        return NtoNWindow_Less_Special(exponents[1], mu1sq_ab, mu2sq_ab, 
+                                       corners);
     }
 
-    const builtin_class a = exponents[0]/2.0; // exponent of alpha (not alpha^2)
     const builtin_class r = exponents[1];     // exponent of r     (not r^2)
     const coeff_class overall = std::sqrt(M_PI)*std::tgamma(0.5 + r/2.0) / 3.0;
 
-    coeff_class hypergeos = 0;
-    for (std::size_t i = 0; i < 2; ++i) {
-        builtin_class mu1 = mu1sq_ab[i];
-        for (std::size_t j = 0; j < 2; ++j) {
-            builtin_class mu2 = mu2sq_ab[j];
-            int sign = (i+j)%2 == 0 ? 1 : -1;
-            builtin_class x = mu1 / mu2;
-
-            coeff_class common = sign * mu1 * std::sqrt(mu2) * std::pow(x, a/2.0);
-
-            hypergeos += common * std::tgamma((a+2.0)/2.0) *
-                Hypergeometric3F2_Reg(0.5, 0.5 + r/2.0, (a+2.0)/2.0,
-                                      r/2.0 + 1.0, (a+2.0)/2.0 + 1.0, x);
-
-            hypergeos -= common * std::tgamma((a-1.0)/2.0) *
-                Hypergeometric3F2_Reg(0.5, 0.5 + r/2.0, (a-1.0)/2.0, 
-                                      r/2.0 + 1.0, (a-1.0)/2.0 + 1.0, x);
-        }
-    }
+    coeff_class hypergeos = corners[0] - corners[1] - corners[2] + corners[3];
 
     if (!std::isfinite(static_cast<builtin_class>(hypergeos))) {
         std::cerr << "Error: NtoNWindow_Less(" << exponents << ", " 
@@ -212,55 +557,64 @@ coeff_class NtoNWindow_Less(const std::array<char,2>& exponents,
     return overall * hypergeos;
 }
 
+// the antiderivative of NtoNWindow_Less at the corner (mu1sq, mu2sq), without
+// the overall constant
+coeff_class NtoNCorner_Less(const std::array<char,2>& exponents,
+                            const builtin_class mu1, const builtin_class mu2) {
+    return NtoNCorners_Less(exponents, mu1, {mu2}).front();
+}
+
+// NtoNCorner_Less(exponents, mu1, mu2[j]) for each j, with the hypergeometric
+// functions for all of the corners evaluated as a batch
+std::vector<coeff_class> NtoNCorners_Less(const std::array<char,2>& exponents,
+                                          const builtin_class mu1, 
+                                          const std::vector<builtin_class>& mu2) {
+    if (exponents[0] == 2) {
+        return NtoNCorners_Less_Special(exponents[1], mu1, mu2);
+    }
+
+    const builtin_class a = exponents[0]/2.0; // exponent of alpha (not alpha^2)
+    std::vector<builtin_class> x(mu2.size());
+    for (std::size_t j = 0; j < mu2.size(); ++j) x[j] = mu1 / mu2[j];
+
+    std::vector<coeff_class> output = NtoNKernel(exponents, x);
+    for (std::size_t j = 0; j < mu2.size(); ++j) {
+        output[j] *= mu1 * std::sqrt(mu2[j]) * std::pow(x[j], a/2.0);
+    }
+    return output;
+}
+
 // this is the special case of NtoNWindow_Less that happens when a == 1, i.e. 
 // there is exactly 1 power of alpha (equivalently, 1/2 power of alpha^2)
 coeff_class NtoNWindow_Less_Special(const builtin_class r, 
                                 const std::array<builtin_class,2>& mu1sq_ab, 
-                                const std::array<builtin_class,2>& mu2sq_ab) {
+                                const std::array<builtin_class,2>& mu2sq_ab,
+                                const std::array<coeff_class,4>& corners) {
     // if the intervals are adjacent, there's a term that becomes indeterminate,
-    // so we'll just use an approximation instead of the real answer; we'd like
-    // to use the trapezoid rule, but that's indeterminate along the boundary as
-    // well, so we use midpoint instead
+    // so we'll just integrate numerically instead (and the corners aren't
+    // used); the hypergeometric has a logarithmic singularity where the
+    // windows touch, which the rule's corner transformation smooths out
     if (mu1sq_ab[1] == mu2sq_ab[0]) {
         builtin_class pref = std::sqrt(M_PI) * std::tgamma((1.0+r)/2.0) / 2.0;
-        auto val = Midpoint_Rectangular([r](builtin_class mu1,builtin_class mu2)
+        auto integrand = [r](builtin_class mu1, builtin_class mu2)
                 { return std::sqrt(mu1)/mu2 * Hypergeometric2F1_Reg(0.5, 
                                                                     0.5+r/2.0,
                                                                     1.0+r/2.0, 
-                                                                    mu1/mu2);},
-                mu1sq_ab, mu2sq_ab, INTEGRAL_SAMPLES);
+                                                                    mu1/mu2);};
+        if (cubatureTolerance > 0) {
+            return pref * CubatureValue(Adaptive_Rectangular(integrand, 
+                            mu1sq_ab, mu2sq_ab, 0, cubatureTolerance),
+                        "NtoNWindow_Less_Special");
+        }
+        auto val = GaussJacobi_Rectangular(integrand, mu1sq_ab, mu2sq_ab, 
+                                           0.5, 0, QUADRATURE_NODES);
         return pref * val;
     }
 
     coeff_class overall = std::sqrt(M_PI) * std::tgamma((r + 3.0)/2.0)
                         / std::tgamma((r + 4.0)/2.0);
 
-    coeff_class hypergeos = 0;
-    for (std::size_t i = 0; i < 2; ++i) {
-        builtin_class mu1 = mu1sq_ab[i];
-        for (std::size_t j = 0; j < 2; ++j) {
-            builtin_class mu2 = mu2sq_ab[j];
-            int sign = (i+j)%2 == 0 ? 1 : -1;
-            builtin_class x = mu1 / mu2;
-
-            coeff_class common = sign * std::pow(mu1, 1.5);
-
-            hypergeos += (common * 8.0 * (r+2.0)) / (9.0 * (r+1.0))
-                       * Hypergeometric2F1(1.5, 0.5 + r/2.0, 1.0 + r/2.0, x);
-
-            hypergeos -= (common * 2.0 * x) / 5.0
-                       * Hypergeometric3F2(1.5, 2.5, 1.5 + r/2.0,
-                                           3.5, 2.0 + r/2.0, x);
-
-            hypergeos -= (common * 8.0 * x) / 15.0
-                       * Hypergeometric3F2(2.5, 2.5, 1.5 + r/2.0,
-                                           3.5, 2.0 + r/2.0, x);
-
-            hypergeos -= (common * 0.5 * x)
-                       * Hypergeometric4F3(1.0, 1.0, 2.5, 1.5 + r/2.0,
-                                           2.0, 2.0, 2.0 + r/2.0, x);
-        }
-    }
+    coeff_class hypergeos = corners[0] - corners[1] - corners[2] + corners[3];
 
     coeff_class output = std::sqrt(M_PI) * std::tgamma(0.5 + r/2.0)
                        / (3 * std::tgamma(1.0 + r/2.0));
@@ -280,6 +634,24 @@ coeff_class NtoNWindow_Less_Special(const builtin_class r,
     return output;
 }
 
+coeff_class NtoNCorner_Less_Special(const builtin_class r, 
+                                    const builtin_class mu1, 
+                                    const builtin_class mu2) {
+    return NtoNCorners_Less_Special(r, mu1, {mu2}).front();
+}
+
+std::vector<coeff_class> NtoNCorners_Less_Special(const builtin_class r, 
+        const builtin_class mu1, const std::vector<builtin_class>& mu2) {
+    std::vector<builtin_class> x(mu2.size());
+    for (std::size_t j = 0; j < mu2.size(); ++j) x[j] = mu1 / mu2[j];
+
+    std::vector<coeff_class> output = NtoNKernel({{2, static_cast<char>(r)}}, 
+                                                 x);
+    coeff_class common = std::pow(mu1, 1.5);
+    for (coeff_class& corner : output) corner *= common;
+    return output;
+}
+
 coeff_class NtoNWindow_Greater(const std::array<char,2>& exponents,
                        const std::array<builtin_class,2>& mu1sq_ab,
                        const std::array<builtin_class,2>& mu2sq_ab) {
@@ -391,90 +763,145 @@ builtin_class NtoNWindow_Equal_Hypergeometric(const builtin_class arg,
 
 // n->n+2 interaction ---------------------------------------------------------
 
+// nr is {n, r}; like MuPart_NtoN, the table is computed the first time each
+// (nr, partitions) is asked for unless PrecomputeMuPart_NPlus2 has done it
 const DMatrix& MuPart_NPlus2(const std::array<char,2>& nr, 
                              const std::size_t partitions) {
-    static std::unordered_map<std::array<char,2>, DMatrix, 
-                              boost::hash<std::array<char,2>> > cache;
-    coeff_class partWidth = coeff_class(1) / partitions;
-    if (cache.count(nr) == 0) {
-        if (nr[0] == 1) {
-            // n=1 only has one state and no g_k norm (n=3 half still has one)
-            DMatrix block(1, partitions);
-            for (std::size_t win = 0; win < partitions; ++win) {
-                block(0, win) = (std::sqrt(win+1) - std::sqrt(win)) / M_PI;
-            }
+    std::uint64_t key = MuPartKey(nr[0], nr[1], 0, partitions);
+    return nPlus2Cache.Get(key, [&nr, partitions]() {
+        if (nr[0] == 1) return NPlus2Table_1(partitions);
 
-            cache.emplace(nr, std::move(block));
-        } else {
-            DMatrix block = DMatrix::Zero(partitions, partitions);
-            for (std::size_t winA = 0; winA < partitions; ++winA) {
-                // entry is 0 when alpha > 1, so winB >= winA; 
-                // when winB == winA, we need to use a special answer as well
-                // because only half of the triangle is included
-                block(winA, winA) = NPlus2Window_Equal(nr[0], nr[1], 
-                                                       winA*partWidth, 
-                                                       (winA+1)*partWidth);
-                for (std::size_t winB = winA+1; winB < partitions; ++winB) {
-                    block(winA, winB) = NPlus2Window_Less(nr[0], nr[1], 
-                            {{static_cast<builtin_class>(winA*partWidth),
-                            static_cast<builtin_class>((winA+1)*partWidth)}},
-                            {{static_cast<builtin_class>(winB*partWidth), 
-                            static_cast<builtin_class>((winB+1)*partWidth)}} );
-                }
-            }
+        DMatrix grid = DMatrix::Zero(partitions, partitions+1);
+        for (std::size_t i = 0; i < partitions; ++i) {
+            NPlus2CornerRow(grid, nr, i);
+        }
+        DMatrix block = DMatrix::Zero(partitions, partitions);
+        for (std::size_t winA = 0; winA < partitions; ++winA) {
+            NPlus2Row(block, grid, nr, winA);
+        }
+        block *= GKNorm(partitions);
+        return block;
+    });
+}
 
-            block *= GKNorm(partitions);
-            cache.emplace(nr, std::move(block));
+// the n+2 counterpart of PrecomputeMuPart_NtoN
+void PrecomputeMuPart_NPlus2(const std::vector<std::array<char,2>>& nrs,
+                             const std::size_t partitions, 
+                             const unsigned int threads) {
+    std::vector<std::array<char,2>> missing;
+    std::unordered_set<std::uint64_t> missingKeys;
+    for (const auto& nr : nrs) {
+        std::uint64_t key = MuPartKey(nr[0], nr[1], 0, partitions);
+        if (nPlus2Cache.Find(key) != nullptr) continue;
+        if (nr[0] == 1) {
+            // a single row of closed-form entries
+            MuPart_NPlus2(nr, partitions);
+        } else if (missingKeys.insert(key).second) {
+            missing.push_back(nr);
         }
     }
 
-    return cache[nr];
+    // as in PrecomputeMuPart_NtoN; n=5 doesn't use any corners
+    if (kernelTolerance > 0) {
+        FillRows(missing.size(), threads, [&](const std::size_t i) {
+            if (missing[i][0] != 5) NPlus2Interpolant(missing[i]);
+        });
+    }
+
+    std::vector<DMatrix> grids(missing.size(), 
+                               DMatrix::Zero(partitions, partitions+1));
+    FillRows(missing.size()*partitions, threads, [&](const std::size_t i) {
+        NPlus2CornerRow(grids[i / partitions], missing[i / partitions], 
+                        i % partitions);
+    });
+    std::vector<DMatrix> blocks(missing.size(), 
+                                DMatrix::Zero(partitions, partitions));
+    FillRows(missing.size()*partitions, threads, [&](const std::size_t i) {
+        NPlus2Row(blocks[i / partitions], grids[i / partitions], 
+                  missing[i / partitions], i % partitions);
+    });
+
+    for (std::size_t k = 0; k < missing.size(); ++k) {
+        blocks[k] *= GKNorm(partitions);
+        nPlus2Cache.Get(MuPartKey(missing[k][0], missing[k][1], 0, partitions),
+                        [&blocks, k]() { return std::move(blocks[k]); });
+    }
 }
 
 coeff_class NPlus2Window_Less(const char n, const char r, 
         const std::array<builtin_class,2>& mu1_ab,
         const std::array<builtin_class,2>& mu2_ab) {
+    std::array<coeff_class,4> corners{};
+    if (n != 5) {
+        for (std::size_t i = 0; i < 2; ++i) {
+            for (std::size_t j = 0; j < 2; ++j) {
+                corners[2*i + j] = NPlus2Corner_Less(n, r, mu1_ab[i], mu2_ab[j]);
+            }
+        }
+    }
+    return NPlus2Window_Less(n, r, mu1_ab, mu2_ab, corners);
+}
+
+// as with NtoNWindow_Less, the corners are those of NPlus2Corner_Less; they're
+// ignored when n=5, which is integrated numerically
+coeff_class NPlus2Window_Less(const char n, const char r, 
+        const std::array<builtin_class,2>& mu1_ab,
+        const std::array<builtin_class,2>& mu2_ab,
+        const std::array<coeff_class,4>& corners) {
     if (n == 5) return NPlus2Window_15_Less(n, r, mu1_ab, mu2_ab);
-    builtin_class a = 0.5 * r;
     coeff_class overall = 8.0 / 3.0;
 
-    coeff_class hypergeos = 0;
-    for (std::size_t i = 0; i < 2; ++i) {
-        coeff_class mu1 = mu1_ab[i];
-        for (std::size_t j = 0; j < 2; ++j) {
-            coeff_class mu2 = mu2_ab[j];
-            int sign = (i+j)%2 == 0 ? 1 : -1;
-
-            builtin_class x = mu1 / mu2;
-
-            coeff_class term = sign * std::pow(mu1, (n+1.0)/4.0) 
-                             / std::pow(mu2, (n-5.0)/4.0);
-            hypergeos += term * 
-                Hypergeometric2F1(-a, (n+1.0)/4.0, (n+5.0)/4.0, x) / (n + 1.0);
-            hypergeos -= term * 
-                Hypergeometric2F1(-a, (n-5.0)/4.0, (n-1.0)/4.0, x) / (n - 5.0);
-        }
-    }
+    coeff_class hypergeos = corners[0] - corners[1] - corners[2] + corners[3];
 
     if (!std::isfinite(static_cast<builtin_class>(hypergeos))) {
-        std::cerr << "Error: NPlus2Window_Less(" << (int)n << ", " << a 
+        std::cerr << "Error: NPlus2Window_Less(" << (int)n << ", " << 0.5*r
             << ", " << mu1_ab << ", " << mu2_ab << ") not finite." 
             << std::endl;
     }
     return overall * hypergeos;
 }
 
+coeff_class NPlus2Corner_Less(const char n, const char r, 
+                              const builtin_class mu1, 
+                              const builtin_class mu2) {
+    return NPlus2Corners_Less(n, r, mu1, {mu2}).front();
+}
+
+// NPlus2Corner_Less(n, r, mu1, mu2[j]) for each j, with the hypergeometric
+// functions for all of the corners evaluated as a batch
+std::vector<coeff_class> NPlus2Corners_Less(const char n, const char r, 
+                                            const builtin_class mu1_in, 
+                                        const std::vector<builtin_class>& mu2) {
+    coeff_class mu1 = mu1_in;
+    std::vector<builtin_class> x(mu2.size());
+    for (std::size_t j = 0; j < mu2.size(); ++j) {
+        x[j] = mu1 / static_cast<coeff_class>(mu2[j]);
+    }
+
+    std::vector<coeff_class> output = NPlus2Kernel({{n, r}}, x);
+    for (std::size_t j = 0; j < mu2.size(); ++j) {
+        output[j] *= std::pow(mu1, (n+1.0)/4.0) 
+                   / std::pow(coeff_class(mu2[j]), (n-5.0)/4.0);
+    }
+    return output;
+}
+
 // when n=1, the general case seems to be unsolvable, so we expand in binomials
 coeff_class NPlus2Window_15_Less(const char n, const char r, 
                                  const std::array<builtin_class,2>& mu1_ab,
                                  const std::array<builtin_class,2>& mu2_ab) {
-    // the analytic answer to this is up to some crazy shit => trapezoid time
+    // the analytic answer to this is up to some crazy shit => quadrature time
     builtin_class a = 0.5*r;
     if (n == 5) {
-        return Simpson_Rectangular(
-                [a](builtin_class mu1, builtin_class mu2)
-                { return std::pow(1.0 - mu1/mu2, a)*std::sqrt(mu1)/mu2; },
-                mu1_ab, mu2_ab, INTEGRAL_SAMPLES);
+        auto integrand = [a](builtin_class mu1, builtin_class mu2)
+                { return std::pow(1.0 - mu1/mu2, a)*std::sqrt(mu1)/mu2; };
+        if (cubatureTolerance > 0) {
+            return CubatureValue(Adaptive_Rectangular(integrand, mu1_ab, mu2_ab,
+                                                      0, cubatureTolerance),
+                                 "NPlus2Window_15_Less");
+        }
+        return GaussJacobi_Rectangular(integrand, mu1_ab, mu2_ab, 0.5, a, 
+                                       QUADRATURE_NODES);
     } else {
         throw std::logic_error("NPlus2Window_15_Less called with invalid n");
     }
@@ -507,7 +934,7 @@ coeff_class NPlus2Window_Equal(const char n, const char r,
 coeff_class NPlus2Window_15_Equal(const char n, const char r, 
                                   const builtin_class mu_a, 
                                   const builtin_class mu_b) {
-    // analytic answer isn't working, so trapezoid this instead
+    // analytic answer isn't working, so integrate this numerically instead
     builtin_class a = 0.5*r;
     std::function<coeff_class(builtin_class,builtin_class)> integrand;
     if (n == 5) {
@@ -517,12 +944,14 @@ coeff_class NPlus2Window_15_Equal(const char n, const char r,
         throw std::logic_error("NPlus2Window_15_Equal called with invalid n");
     }
 
-    if (mu_a == 0) {
-        // (integrable) divergence in trapezoid, use midpoint instead
-        return Midpoint_Triangular(integrand, mu_a, mu_b, INTEGRAL_SAMPLES);
-    } else {
-        return Trapezoid_Triangular(integrand, mu_a, mu_b, INTEGRAL_SAMPLES);
+    if (cubatureTolerance > 0) {
+        return CubatureValue(Adaptive_Triangular(integrand, mu_a, mu_b, 0, 
+                                                 cubatureTolerance),
+                             "NPlus2Window_15_Equal");
     }
+    // the integrand scales like mu^(-1/2)
+    return GaussJacobi_Triangular(integrand, mu_a, mu_b, 0.5, a, -0.5, 
+                                  QUADRATURE_NODES);
 }
 
 // numerical integrals --------------------------------------------------------
@@ -750,6 +1179,313 @@ coeff_class Simpson_Triangular(
     return rectValue*(width*width)/4.0 + triValue*(width*width/2.0)/3.0;
 }
 
+namespace {
+
+ConcurrentCache<std::array<builtin_class,3>, QuadratureRule,
+                boost::hash<std::array<builtin_class,3>>> gaussJacobiRules;
+
+// Golub-Welsch: the nodes are the eigenvalues of the Jacobi matrix of the
+// orthogonal polynomials, and the weights come from the first components of
+// its eigenvectors; this is on [-1, 1] with weight (1-x)^alpha (1+x)^beta
+QuadratureRule ComputeGaussJacobi(const std::size_t nodes, 
+                                  const builtin_class alpha,
+                                  const builtin_class beta) {
+    Eigen::VectorXd diagonal(nodes);
+    Eigen::VectorXd subdiagonal(nodes > 1 ? nodes - 1 : 0);
+    diagonal(0) = (beta - alpha) / (alpha + beta + 2.0);
+    for (std::size_t k = 1; k < nodes; ++k) {
+        builtin_class s = 2.0*k + alpha + beta;
+        diagonal(k) = (beta*beta - alpha*alpha) / (s * (s + 2.0));
+        subdiagonal(k-1) = std::sqrt(4.0*k * (k + alpha) * (k + beta) 
+                                     * (k + alpha + beta)
+                                     / (s * s * (s + 1.0) * (s - 1.0)));
+    }
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver;
+    solver.computeFromTridiagonal(diagonal, subdiagonal);
+
+    // moving to [0, 1] turns the weight into 2^(alpha+beta) (1-t)^alpha t^beta, 
+    // whose total is the beta function
+    builtin_class total = std::tgamma(alpha + 1.0) * std::tgamma(beta + 1.0)
+                        / std::tgamma(alpha + beta + 2.0);
+    QuadratureRule rule;
+    for (std::size_t i = 0; i < nodes; ++i) {
+        builtin_class t = (1.0 + solver.eigenvalues()(i)) / 2.0;
+        builtin_class v0 = solver.eigenvectors()(0, i);
+        rule.nodes.push_back(t);
+        rule.weights.push_back(total * v0 * v0 
+                               / (std::pow(1.0 - t, alpha) * std::pow(t, beta)));
+    }
+    return rule;
+}
+
+} // anonymous namespace
+
+const QuadratureRule& GaussJacobi(const std::size_t nodes, 
+                                  const builtin_class alpha,
+                                  const builtin_class beta) {
+    if (nodes == 0 || !(alpha > -1) || !(beta > -1)) {
+        throw std::invalid_argument(__FILE__ ": GaussJacobi needs at least one "
+                                    "node and exponents above -1");
+    }
+    return gaussJacobiRules.Get({{builtin_class(nodes), alpha, beta}}, 
+            [=]() { return ComputeGaussJacobi(nodes, alpha, beta); });
+}
+
+// Gauss-Jacobi approximation to an integral over a rectangular area on or above
+// the diagonal (i.e. mu1_ab[1] <= mu2_ab[0]), for integrands which go like 
+// mu1^axisPower near mu1 = 0 and like (mu2 - mu1)^diagonalPower near mu1 = mu2
+coeff_class GaussJacobi_Rectangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2>& mu1_ab, 
+        const std::array<builtin_class,2>& mu2_ab,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const std::size_t nodes) {
+    if (mu1_ab[1] == mu1_ab[0] || mu2_ab[1] == mu2_ab[0] || nodes == 0) {
+        return 0;
+    }
+    const builtin_class width1 = mu1_ab[1] - mu1_ab[0];
+    const builtin_class width2 = mu2_ab[1] - mu2_ab[0];
+
+    // if the window doesn't touch the diagonal, only the axis can be singular
+    if (mu1_ab[1] < mu2_ab[0]) {
+        const QuadratureRule& rule1 = GaussJacobi(nodes, 0, 
+                                            mu1_ab[0] == 0 ? axisPower : 0);
+        const QuadratureRule& rule2 = GaussJacobi(nodes, 0, 0);
+        coeff_class value = 0;
+        for (std::size_t i = 0; i < nodes; ++i) {
+            builtin_class mu1 = mu1_ab[0] + rule1.nodes[i]*width1;
+            coeff_class row = 0;
+            for (std::size_t j = 0; j < nodes; ++j) {
+                builtin_class mu2 = mu2_ab[0] + rule2.nodes[j]*width2;
+                row += rule2.weights[j] * integrand(mu1, mu2);
+            }
+            value += rule1.weights[i] * row;
+        }
+        return value * width1 * width2;
+    }
+
+    // if it touches both, split it so that each half only touches one
+    if (mu1_ab[0] == 0) {
+        const builtin_class middle = mu1_ab[1] / 2;
+        return GaussJacobi_Rectangular(integrand, {{0, middle}}, mu2_ab,
+                                       axisPower, diagonalPower, nodes)
+             + GaussJacobi_Rectangular(integrand, {{middle, mu1_ab[1]}}, mu2_ab,
+                                       axisPower, diagonalPower, nodes);
+    }
+
+    // otherwise the singularity is at the corner c = mu1_ab[1] = mu2_ab[0];
+    // split the window along its diagonal through c and map each half onto 
+    // the unit square (Duffy's transformation) with s measuring the distance 
+    // from c, so that the singular factor and the Jacobian both go like powers 
+    // of s alone. Taking s = sigma^2 on top of that also smooths out the 
+    // logarithms which turn up when diagonalPower is 0.
+    const builtin_class c = mu1_ab[1];
+    const QuadratureRule& ruleS = GaussJacobi(nodes, 0, 2*diagonalPower + 3);
+    const QuadratureRule& ruleT = GaussJacobi(nodes, 0, 0);
+    coeff_class value = 0;
+    for (std::size_t i = 0; i < nodes; ++i) {
+        const builtin_class sigma = ruleS.nodes[i];
+        const builtin_class s = sigma*sigma;
+        coeff_class row = 0;
+        for (std::size_t j = 0; j < nodes; ++j) {
+            const builtin_class t = ruleT.nodes[j];
+            row += ruleT.weights[j] * (integrand(c - s*width1, c + s*t*width2)
+                                     + integrand(c - s*t*width1, c + s*width2));
+        }
+        value += ruleS.weights[i] * 2*sigma*s * row;
+    }
+    return value * width1 * width2;
+}
+
+// Gauss-Jacobi approximation to an integral over the triangle with
+// mu_a <= mu1 <= mu2 <= mu_b, for integrands which go like mu1^axisPower near
+// mu1 = 0 and like (mu2 - mu1)^diagonalPower near mu1 = mu2, and which get 
+// multiplied by lambda^scalingPower when mu1 and mu2 are both scaled by lambda
+coeff_class GaussJacobi_Triangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class scalingPower, const std::size_t nodes) {
+    if (mu_a == mu_b || nodes == 0) return 0;
+
+    // Duffy's transformation collapses the unit square onto the triangle: 
+    // mu2 = mu_a + u*width and mu1 = mu_a + u*v*width, so the diagonal is at 
+    // v = 1 and the corner (mu_a, mu_a) is at u = 0. If mu_a = 0, the axis is
+    // at v = 0 and the integrand goes like u^scalingPower; otherwise it only 
+    // sees the diagonal, through u^diagonalPower. Either way the Jacobian 
+    // adds one more power of u.
+    const builtin_class width = mu_b - mu_a;
+    const QuadratureRule& ruleU = GaussJacobi(nodes, 0, 
+            (mu_a == 0 ? scalingPower : diagonalPower) + 1);
+    const QuadratureRule& ruleV = GaussJacobi(nodes, diagonalPower,
+                                              mu_a == 0 ? axisPower : 0);
+    coeff_class value = 0;
+    for (std::size_t i = 0; i < nodes; ++i) {
+        const builtin_class mu2 = mu_a + ruleU.nodes[i]*width;
+        coeff_class row = 0;
+        for (std::size_t j = 0; j < nodes; ++j) {
+            const builtin_class mu1 = mu_a + ruleU.nodes[i]*ruleV.nodes[j]*width;
+            row += ruleV.weights[j] * integrand(mu1, mu2);
+        }
+        value += ruleU.weights[i] * ruleU.nodes[i] * row;
+    }
+    return value * width * width;
+}
+
+namespace {
+
+// a piece of the domain of an adaptive cubature, with its estimate and error
+struct CubatureRegion {
+    std::array<builtin_class,2> center;
+    std::array<builtin_class,2> halfWidth;
+    coeff_class value;
+    coeff_class error;
+    std::size_t splitAxis;
+
+    // so that the heap of regions has the largest error on top
+    bool operator<(const CubatureRegion& other) const { 
+        return error < other.error;
+    }
+};
+
+// Genz and Malik's embedded pair of degree 7 and 5 rules in two dimensions: the
+// difference between them is the error estimate, and the axis along which the
+// fourth differences are largest is the one along which to split. Both rules
+// only use the 17 points inside the region, none on its boundary.
+CubatureRegion GenzMalik(
+        const std::function<coeff_class(builtin_class,builtin_class)>& integrand,
+        const std::array<builtin_class,2>& center,
+        const std::array<builtin_class,2>& halfWidth) {
+    constexpr builtin_class lambda2 = 0.35856858280031806; // sqrt(9/70)
+    constexpr builtin_class lambda3 = 0.9486832980505138;  // sqrt(9/10)
+    constexpr builtin_class lambda5 = 0.6882472016116853;  // sqrt(9/19)
+    // weights of the degree 7 rule and then the degree 5 rule
+    constexpr builtin_class w1 = -3816.0/19683, w2 = 980.0/6561;
+    constexpr builtin_class w3 = 1020.0/19683, w4 = 200.0/19683;
+    constexpr builtin_class w5 = 6859.0/78732;
+    constexpr builtin_class v1 = -971.0/729, v2 = 245.0/486;
+    constexpr builtin_class v3 = 65.0/1458, v4 = 25.0/729;
+
+    auto f = [&](const builtin_class d0, const builtin_class d1) {
+        return integrand(center[0] + d0*halfWidth[0], 
+                         center[1] + d1*halfWidth[1]);
+    };
+
+    const coeff_class f0 = f(0, 0);
+    coeff_class sum2 = 0, sum3 = 0, sum4 = 0, sum5 = 0;
+    std::array<coeff_class,2> fourthDifference;
+    for (std::size_t axis = 0; axis < 2; ++axis) {
+        coeff_class f2 = axis == 0 ? f(lambda2, 0) + f(-lambda2, 0)
+                                   : f(0, lambda2) + f(0, -lambda2);
+        coeff_class f3 = axis == 0 ? f(lambda3, 0) + f(-lambda3, 0)
+                                   : f(0, lambda3) + f(0, -lambda3);
+        sum2 += f2;
+        sum3 += f3;
+        fourthDifference[axis] = (f2 - 2*f0) 
+                               - (lambda2*lambda2)/(lambda3*lambda3)*(f3 - 2*f0);
+        if (fourthDifference[axis] < 0) {
+            fourthDifference[axis] = -fourthDifference[axis];
+        }
+    }
+    for (builtin_class s0 : {-1.0, 1.0}) {
+        for (builtin_class s1 : {-1.0, 1.0}) {
+            sum4 += f(s0*lambda3, s1*lambda3);
+            sum5 += f(s0*lambda5, s1*lambda5);
+        }
+    }
+
+    const builtin_class volume = 4*halfWidth[0]*halfWidth[1];
+    CubatureRegion region;
+    region.center = center;
+    region.halfWidth = halfWidth;
+    region.value = volume*(w1*f0 + w2*sum2 + w3*sum3 + w4*sum4 + w5*sum5);
+    coeff_class lower = volume*(v1*f0 + v2*sum2 + v3*sum3 + v4*sum4);
+    region.error = region.value > lower ? region.value - lower 
+                                        : lower - region.value;
+    // if the differences can't tell the axes apart, split the longer side
+    if (fourthDifference[0] == fourthDifference[1]) {
+        region.splitAxis = halfWidth[0] >= halfWidth[1] ? 0 : 1;
+    } else {
+        region.splitAxis = fourthDifference[0] > fourthDifference[1] ? 0 : 1;
+    }
+    return region;
+}
+
+} // anonymous namespace
+
+// Adaptive cubature over a rectangular area: the region with the largest error
+// estimate is bisected until the total error is within the larger of the two
+// tolerances, or until the next bisection would take more than maxEvaluations.
+// Since the rule never evaluates the integrand on the boundary, integrable
+// singularities along the edges are fine; they just take more bisections.
+CubatureResult Adaptive_Rectangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2>& mu1_ab, 
+        const std::array<builtin_class,2>& mu2_ab,
+        const builtin_class absTolerance, const builtin_class relTolerance,
+        const std::size_t maxEvaluations) {
+    constexpr std::size_t evaluationsPerRegion = 17;
+    if (mu1_ab[1] == mu1_ab[0] || mu2_ab[1] == mu2_ab[0]) return {0, 0};
+
+    std::vector<CubatureRegion> regions;
+    regions.push_back(GenzMalik(integrand, 
+                {{(mu1_ab[0] + mu1_ab[1])/2, (mu2_ab[0] + mu2_ab[1])/2}},
+                {{(mu1_ab[1] - mu1_ab[0])/2, (mu2_ab[1] - mu2_ab[0])/2}}));
+    std::size_t evaluations = evaluationsPerRegion;
+    coeff_class value = regions.front().value;
+    coeff_class error = regions.front().error;
+
+    while (evaluations + 2*evaluationsPerRegion <= maxEvaluations) {
+        builtin_class magnitude = std::abs(static_cast<builtin_class>(value));
+        if (error <= std::max(absTolerance, relTolerance*magnitude)) break;
+
+        std::pop_heap(regions.begin(), regions.end());
+        CubatureRegion worst = regions.back();
+        regions.pop_back();
+        value -= worst.value;
+        error -= worst.error;
+
+        std::array<builtin_class,2> halfWidth = worst.halfWidth;
+        halfWidth[worst.splitAxis] /= 2;
+        for (builtin_class side : {-1.0, 1.0}) {
+            std::array<builtin_class,2> center = worst.center;
+            center[worst.splitAxis] += side*halfWidth[worst.splitAxis];
+            CubatureRegion half = GenzMalik(integrand, center, halfWidth);
+            value += half.value;
+            error += half.error;
+            regions.push_back(std::move(half));
+            std::push_heap(regions.begin(), regions.end());
+        }
+        evaluations += 2*evaluationsPerRegion;
+    }
+
+    // the running totals pick up rounding errors from all of the subtractions,
+    // so add everything up again from scratch
+    CubatureResult result{0, 0};
+    for (const CubatureRegion& region : regions) {
+        result.value += region.value;
+        result.error += region.error;
+    }
+    return result;
+}
+
+// Adaptive cubature over the triangle with mu_a <= mu1 <= mu2 <= mu_b, done on
+// the unit square by way of the same transformation as GaussJacobi_Triangular
+CubatureResult Adaptive_Triangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class absTolerance, const builtin_class relTolerance,
+        const std::size_t maxEvaluations) {
+    if (mu_a == mu_b) return {0, 0};
+
+    const builtin_class width = mu_b - mu_a;
+    auto square = [&integrand, mu_a, width](builtin_class u, builtin_class v)
+        { return (width*width*u) 
+                 * integrand(mu_a + u*v*width, mu_a + u*width); };
+    return Adaptive_Rectangular(square, {{0, 1}}, {{0, 1}}, 
+                                absTolerance, relTolerance, maxEvaluations);
+}
+
 // used for the coordinate transformation that rectangularizes the Equal cells
 builtin_class XofUV(const builtin_class u, const builtin_class v, 
                     const std::array<builtin_class,2>& musq_ab) {
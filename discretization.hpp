@@ -4,9 +4,13 @@
 #include <array>
 #include <vector>
 #include <cmath>
+#include <algorithm> // std::max
 #include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <functional> // std::function
 
 #include <boost/functional/hash.hpp>
 #include <gsl/gsl_sf_gamma.h> // for beta function
@@ -14,6 +18,9 @@
 #include "constants.hpp"
 #include "hypergeo.hpp"
 #include "multinomial.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+#include "chebyshev.hpp"
 
 SMatrix DiscretizePolys(const DMatrix& polysOnMinBasis, 
                         std::size_t partitions);
@@ -30,17 +37,40 @@ DMatrix MuPart_1(const MATRIX_TYPE type);
 
 // same-n interactions --------------------------------------------------------
 
+void InterpolateKernels(const builtin_class tolerance);
+void IntegrateAdaptively(const builtin_class tolerance);
+
 const DMatrix& MuPart_NtoN(const unsigned int n, 
                            std::array<char,2> exponents, 
                            const std::size_t partitions);
+void PrecomputeMuPart_NtoN(const unsigned int n, 
+                           const std::vector<std::array<char,2>>& exponents,
+                           const std::size_t partitions, 
+                           const unsigned int threads = 1);
 std::unique_ptr<DMatrix> MuPart_2to2(const std::size_t partitions);
 
 coeff_class NtoNWindow_Less(const std::array<char,2>& exponents,
                        const std::array<builtin_class,2>& mu1sq_ab,
                        const std::array<builtin_class,2>& mu2sq_ab);
+coeff_class NtoNWindow_Less(const std::array<char,2>& exponents,
+                       const std::array<builtin_class,2>& mu1sq_ab,
+                       const std::array<builtin_class,2>& mu2sq_ab,
+                       const std::array<coeff_class,4>& corners);
+coeff_class NtoNCorner_Less(const std::array<char,2>& exponents,
+                            const builtin_class mu1sq, 
+                            const builtin_class mu2sq);
+std::vector<coeff_class> NtoNCorners_Less(const std::array<char,2>& exponents,
+                                          const builtin_class mu1sq, 
+                                const std::vector<builtin_class>& mu2sq);
 coeff_class NtoNWindow_Less_Special(const builtin_class r, 
                                 const std::array<builtin_class,2>& mu1sq_ab, 
-                                const std::array<builtin_class,2>& mu2sq_ab);
+                                const std::array<builtin_class,2>& mu2sq_ab,
+                                const std::array<coeff_class,4>& corners);
+coeff_class NtoNCorner_Less_Special(const builtin_class r, 
+                                    const builtin_class mu1sq, 
+                                    const builtin_class mu2sq);
+std::vector<coeff_class> NtoNCorners_Less_Special(const builtin_class r, 
+        const builtin_class mu1sq, const std::vector<builtin_class>& mu2sq);
 coeff_class NtoNWindow_Greater(const std::array<char,2>& exponents,
                        const std::array<builtin_class,2>& mu1sq_ab,
                        const std::array<builtin_class,2>& mu2sq_ab);
@@ -58,10 +88,21 @@ builtin_class NtoNWindow_Equal_Hypergeometric(const builtin_class arg,
 
 const DMatrix& MuPart_NPlus2(const std::array<char,2>& nr, 
                              const std::size_t partitions);
+void PrecomputeMuPart_NPlus2(const std::vector<std::array<char,2>>& nrs,
+                             const std::size_t partitions, 
+                             const unsigned int threads = 1);
 
 coeff_class NPlus2Window_Less(const char n, const char r,
         const std::array<builtin_class,2>& mu1_ab,
         const std::array<builtin_class,2>& mu2_ab);
+coeff_class NPlus2Window_Less(const char n, const char r,
+        const std::array<builtin_class,2>& mu1_ab,
+        const std::array<builtin_class,2>& mu2_ab,
+        const std::array<coeff_class,4>& corners);
+coeff_class NPlus2Corner_Less(const char n, const char r, 
+                              const builtin_class mu1, const builtin_class mu2);
+std::vector<coeff_class> NPlus2Corners_Less(const char n, const char r, 
+        const builtin_class mu1, const std::vector<builtin_class>& mu2);
 coeff_class NPlus2Window_Equal(const char n, const char r, 
         const builtin_class mu_a, const builtin_class mu_b);
 coeff_class NPlus2Window_15_Less(const char n, const char r, 
@@ -102,6 +143,47 @@ coeff_class Simpson_Rectangular(
         const std::array<builtin_class,2>& mu2_ab,
         const std::size_t samples);
 
+// Gauss-Jacobi rule on [0, 1] for integrands which go like (1-t)^alpha t^beta
+// times something smooth; the weights have the singular factors divided back
+// out, so the integral of f is the sum of weights[i]*f(nodes[i])
+struct QuadratureRule {
+    std::vector<builtin_class> nodes;
+    std::vector<builtin_class> weights;
+};
+const QuadratureRule& GaussJacobi(const std::size_t nodes, 
+                                  const builtin_class alpha,
+                                  const builtin_class beta);
+coeff_class GaussJacobi_Rectangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2>& mu1_ab, 
+        const std::array<builtin_class,2>& mu2_ab,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const std::size_t nodes);
+coeff_class GaussJacobi_Triangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class scalingPower, const std::size_t nodes);
+
+// adaptive integrals, for which the evaluations are spent where they're needed
+// and which come with an estimate of their (absolute) error
+constexpr std::size_t ADAPTIVE_MAX_EVALUATIONS = 100000;
+struct CubatureResult {
+    coeff_class value;
+    coeff_class error;
+};
+CubatureResult Adaptive_Rectangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2>& mu1_ab, 
+        const std::array<builtin_class,2>& mu2_ab,
+        const builtin_class absTolerance, const builtin_class relTolerance,
+        const std::size_t maxEvaluations = ADAPTIVE_MAX_EVALUATIONS);
+CubatureResult Adaptive_Triangular(
+        const std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class absTolerance, const builtin_class relTolerance,
+        const std::size_t maxEvaluations = ADAPTIVE_MAX_EVALUATIONS);
+
 // used for the coordinate transformation that rectangularizes the Equal cells
 builtin_class XofUV(const builtin_class u, const builtin_class v, 
                     const std::array<builtin_class,2>& musq_ab);
@@ -0,0 +1,230 @@
+#include "element_cache.hpp"
+
+namespace ElementCache {
+
+namespace {
+
+// first line of every entry; change this if the meaning of a stored value ever
+// changes, so that old directories are ignored instead of misread
+constexpr char FORMAT[] = "3dBasis element cache v1";
+
+boost::filesystem::path cacheDir;
+
+typedef std::vector<std::pair<std::array<char,2>, coeff_class>> Rows;
+
+// coefficients are written as their raw bytes so they come back exactly
+std::string HexBytes(const coeff_class value) {
+    static constexpr char digits[] = "0123456789abcdef";
+    unsigned char bytes[sizeof(coeff_class)];
+    std::memcpy(bytes, &value, sizeof(coeff_class));
+    std::string output;
+    output.reserve(2*sizeof(coeff_class));
+    for (unsigned char byte : bytes) {
+        output += digits[byte >> 4];
+        output += digits[byte & 0xF];
+    }
+    return output;
+}
+
+int HexDigit(const char digit) {
+    if (digit >= '0' && digit <= '9') return digit - '0';
+    if (digit >= 'a' && digit <= 'f') return digit - 'a' + 10;
+    return -1;
+}
+
+bool ReadHexBytes(const std::string& hex, coeff_class& value) {
+    if (hex.size() != 2*sizeof(coeff_class)) return false;
+    unsigned char bytes[sizeof(coeff_class)];
+    for (std::size_t i = 0; i < sizeof(coeff_class); ++i) {
+        int high = HexDigit(hex[2*i]);
+        int low = HexDigit(hex[2*i + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = 16*high + low;
+    }
+    std::memcpy(&value, bytes, sizeof(coeff_class));
+    return true;
+}
+
+// monomials stand for symmetric polynomials, so the order of the particles
+// doesn't matter and the ordered copy is used as the canonical form
+std::string MonoKey(const Mono& mono) {
+    Mono ordered = mono.OrderCopy();
+    std::string output = HexBytes(ordered.Coeff());
+    for (std::size_t i = 0; i < ordered.NParticles(); ++i) {
+        output += ' ' + std::to_string(ordered.Pm(i)) + ','
+                + std::to_string(ordered.Pt(i));
+    }
+    return output;
+}
+
+// the size of coeff_class is part of the key so that a directory written by a
+// build with a different coeff_class isn't misread
+std::string Key(const Mono& A, const Mono& B, const MATRIX_TYPE type) {
+    return "type " + std::to_string(type)
+        + " coeff " + std::to_string(sizeof(coeff_class))
+        + " A " + MonoKey(A) + " B " + MonoKey(B);
+}
+
+// 64-bit FNV-1a of the key, as 16 hex digits
+std::string HashName(const std::string& key) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string output(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        output[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return output;
+}
+
+boost::filesystem::path EntryPath(const std::string& key) {
+    std::string name = HashName(key);
+    // spread the entries over 256 subdirectories so none of them gets huge
+    return cacheDir / name.substr(0, 2) / name;
+}
+
+// only complain about the first failed write; if one fails, they probably all
+// will (e.g. because the disk is full), and the results are still correct
+void WarnWriteFailed(const boost::filesystem::path& path) {
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true)) {
+        std::cerr << "Warning: couldn't write to the element cache at "
+            << path.string() << "; elements will be computed but not stored."
+            << std::endl;
+    }
+}
+
+bool ReadEntry(const std::string& key, Rows& rows) {
+    if (cacheDir.empty()) return false;
+
+    boost::filesystem::path path = EntryPath(key);
+    std::ifstream file(path.string());
+    if (!file) return false;
+
+    std::string line;
+    if (!std::getline(file, line) || line != FORMAT) {
+        std::cerr << "Warning: ignoring unreadable element cache entry "
+            << path.string() << std::endl;
+        return false;
+    }
+    // a different key is a hash collision, which is just a miss
+    if (!std::getline(file, line) || line != key) return false;
+
+    std::size_t count;
+    if (!(file >> count)) {
+        std::cerr << "Warning: ignoring unreadable element cache entry "
+            << path.string() << std::endl;
+        return false;
+    }
+    rows.clear();
+    rows.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        int alpha, r;
+        std::string hex;
+        coeff_class coeff;
+        if (!(file >> alpha >> r >> hex) || !ReadHexBytes(hex, coeff)) {
+            std::cerr << "Warning: ignoring unreadable element cache entry "
+                << path.string() << std::endl;
+            return false;
+        }
+        rows.emplace_back(std::array<char,2>{{static_cast<char>(alpha),
+                                              static_cast<char>(r)}}, coeff);
+    }
+    return true;
+}
+
+void WriteEntry(const std::string& key, const Rows& rows) {
+    if (cacheDir.empty()) return;
+
+    boost::filesystem::path path = EntryPath(key);
+    boost::system::error_code error;
+    boost::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        WarnWriteFailed(path);
+        return;
+    }
+
+    // write somewhere no other thread can be writing, then move it into place
+    // all at once so that readers never see a partial entry
+    boost::filesystem::path temp = path.parent_path()
+        / boost::filesystem::unique_path(path.filename().string()
+                                         + ".%%%%-%%%%-%%%%.tmp");
+    {
+        std::ofstream file(temp.string());
+        file << FORMAT << '\n' << key << '\n' << rows.size() << '\n';
+        for (const auto& row : rows) {
+            file << static_cast<int>(row.first[0]) << ' '
+                << static_cast<int>(row.first[1]) << ' '
+                << HexBytes(row.second) << '\n';
+        }
+        file.close();
+        if (!file) {
+            boost::filesystem::remove(temp, error);
+            WarnWriteFailed(path);
+            return;
+        }
+    }
+
+    boost::filesystem::rename(temp, path, error);
+    if (error) {
+        boost::filesystem::remove(temp, error);
+        WarnWriteFailed(path);
+    }
+}
+
+} // anonymous namespace
+
+void Open(const std::string& directory) {
+    try {
+        boost::filesystem::create_directories(directory);
+    }
+    catch (const boost::filesystem::filesystem_error& e) {
+        throw std::runtime_error(__FILE__ ": couldn't open element cache "
+                                 "directory " + directory + ": " + e.what());
+    }
+    cacheDir = directory;
+}
+
+void Close() {
+    cacheDir.clear();
+}
+
+bool IsOpen() {
+    return !cacheDir.empty();
+}
+
+// scalars are stored as a single row with exponents (0, 0)
+bool Lookup(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+            coeff_class& output) {
+    Rows rows;
+    if (!ReadEntry(Key(A, B, type), rows) || rows.size() != 1) return false;
+    output = rows.front().second;
+    return true;
+}
+
+bool Lookup(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+            ExponentMap& output) {
+    Rows rows;
+    if (!ReadEntry(Key(A, B, type), rows)) return false;
+    output.clear();
+    output.insert(rows.begin(), rows.end());
+    return true;
+}
+
+void Store(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+           const coeff_class value) {
+    if (!IsOpen()) return;
+    WriteEntry(Key(A, B, type), Rows(1, {{{0, 0}}, value}));
+}
+
+void Store(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+           const ExponentMap& value) {
+    if (!IsOpen()) return;
+    WriteEntry(Key(A, B, type), Rows(value.begin(), value.end()));
+}
+
+} // namespace ElementCache
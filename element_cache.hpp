@@ -0,0 +1,65 @@
+#ifndef ELEMENT_CACHE_HPP
+#define ELEMENT_CACHE_HPP
+
+// Persistent store for the parts of the matrix elements which depend only on
+// the pair of monomials: the Fock space scalar for the direct operators, and
+// the map of (alpha, r) exponents to coefficients for the interactions, before
+// any discretization. None of these depend on kMax, m^2, lambda or the cutoff,
+// so the same directory can be shared by every run over the same bases.
+//
+// Entries are content-addressed: each one lives in a file named after a hash
+// of (operator type, ordered A, ordered B) and the full key is written inside
+// the file, so a hash collision is just a miss. Values are written bit for bit,
+// so a run reading from the cache gives exactly the same matrices as one
+// computing everything. Files are written to a temporary name and then renamed
+// into place, so any number of threads (or processes) can use the same
+// directory at once; concurrent writers of one entry all write the same thing.
+//
+// The cache does nothing until Open() is called, so by default every element
+// is computed as before.
+
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/functional/hash.hpp>
+#include <boost/filesystem.hpp>
+
+#include "constants.hpp"
+#include "mono.hpp"
+
+namespace ElementCache {
+
+// (alpha, r) exponents -> coefficient; matrix.hpp calls this NtoN_Final
+typedef std::unordered_map<std::array<char,2>, coeff_class,
+                           boost::hash<std::array<char,2>> > ExponentMap;
+
+// start reading and writing entries in directory, creating it if necessary;
+// this is not thread-safe, so do it before computing any matrices
+void Open(const std::string& directory);
+// stop using the cache; also not thread-safe
+void Close();
+bool IsOpen();
+
+// each Lookup returns true and sets output if (A, B, type) is stored; if the
+// cache isn't open, Lookup always returns false and Store does nothing
+bool Lookup(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+            coeff_class& output);
+bool Lookup(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+            ExponentMap& output);
+void Store(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+           const coeff_class value);
+void Store(const Mono& A, const Mono& B, const MATRIX_TYPE type,
+           const ExponentMap& value);
+
+} // namespace ElementCache
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef EXPONENTS_HPP
+#define EXPONENTS_HPP
+
+#include <array>
+#include <algorithm> // std::fill, std::copy, std::equal
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility> // std::swap
+
+// Replacement for std::vector<char> used for the lists of exponents in the
+// MatrixTerm structs. The number of exponents is at most about twice the
+// number of particles, so they can be stored inline with a fixed capacity and
+// terms can be built, copied, and combined without touching the heap.
+//
+// Like std::vector, elements added by resize() are set to zero unless told
+// otherwise. Asking for more than CAPACITY entries throws std::length_error.
+
+class ExponentVector {
+    public:
+        // enough for the n+2 interaction's 2n+2 u exponents up to n = 14
+        static constexpr std::size_t CAPACITY = 31;
+
+        using value_type = char;
+        using size_type = std::size_t;
+        using iterator = char*;
+        using const_iterator = const char*;
+
+        ExponentVector(): count(0) {}
+        explicit ExponentVector(const size_type n, const char value = 0);
+        ExponentVector(std::initializer_list<char> init);
+
+        size_type size() const { return count; }
+        bool empty() const { return count == 0; }
+        void resize(const size_type n, const char value = 0);
+        void push_back(const char value);
+        void clear() { count = 0; }
+
+        char& operator[](const size_type i) { return entries[i]; }
+        char operator[](const size_type i) const { return entries[i]; }
+        char& front() { return entries[0]; }
+        char front() const { return entries[0]; }
+        char& back() { return entries[count-1]; }
+        char back() const { return entries[count-1]; }
+
+        iterator begin() { return entries.data(); }
+        iterator end() { return entries.data() + count; }
+        const_iterator begin() const { return entries.data(); }
+        const_iterator end() const { return entries.data() + count; }
+
+    private:
+        std::array<char, CAPACITY> entries;
+        unsigned char count;
+
+        static void CheckCapacity(const size_type n);
+};
+
+inline void ExponentVector::CheckCapacity(const size_type n) {
+    if (n > CAPACITY) {
+        throw std::length_error(__FILE__ ": asked for " + std::to_string(n)
+                + " exponents but ExponentVector only holds "
+                + std::to_string(CAPACITY));
+    }
+}
+
+inline ExponentVector::ExponentVector(const size_type n, const char value) {
+    CheckCapacity(n);
+    count = n;
+    std::fill(begin(), end(), value);
+}
+
+inline ExponentVector::ExponentVector(std::initializer_list<char> init) {
+    CheckCapacity(init.size());
+    count = init.size();
+    std::copy(init.begin(), init.end(), begin());
+}
+
+inline void ExponentVector::resize(const size_type n, const char value) {
+    CheckCapacity(n);
+    if (n > count) std::fill(end(), begin() + n, value);
+    count = n;
+}
+
+inline void ExponentVector::push_back(const char value) {
+    CheckCapacity(count + 1u);
+    entries[count++] = value;
+}
+
+inline bool operator==(const ExponentVector& A, const ExponentVector& B) {
+    return A.size() == B.size() && std::equal(A.begin(), A.end(), B.begin());
+}
+
+inline bool operator!=(const ExponentVector& A, const ExponentVector& B) {
+    return !(A == B);
+}
+
+// counterpart of AddVectors from constants.hpp: the output has the size of the
+// longer input, with the shorter one added to the front of it
+inline ExponentVector AddVectors(const ExponentVector& A,
+                                 const ExponentVector& B) {
+    const ExponentVector* aP = &A;
+    const ExponentVector* bP = &B;
+    if (A.size() < B.size()) std::swap(aP, bP);
+    ExponentVector output(*aP);
+    for (std::size_t i = 0; i < bP->size(); ++i) output[i] += (*bP)[i];
+    return output;
+}
+
+#endif
@@ -2,28 +2,24 @@
 
 coeff_class Hypergeometric2F1(const builtin_class a, const builtin_class b,
         const builtin_class c, const builtin_class x) {
-    static std::unordered_map< std::array<builtin_class,4>,coeff_class,
-                          boost::hash<std::array<builtin_class,4>> > hg2f1Cache;
+    static ConcurrentCache<std::array<builtin_class,4>, coeff_class,
+                           boost::hash<std::array<builtin_class,4>> > hg2f1Cache;
 
     const std::array<builtin_class,4> params = {{a, b, c, x}};
-    if (hg2f1Cache.count(params) == 0) {
-        hg2f1Cache.emplace(params, HypergeometricPFQ<2,1>({{a,b}}, {{c}}, x));
-    }
-
-    return hg2f1Cache[params];
+    return hg2f1Cache.Get(params, [a, b, c, x]() {
+            return HypergeometricPFQ<2,1>({{a,b}}, {{c}}, x);
+        });
 }
 
 coeff_class Hypergeometric2F1_Reg(const builtin_class a, const builtin_class b,
                                   const builtin_class c, const builtin_class x){
-    static std::unordered_map< std::array<builtin_class,4>,coeff_class,
-                          boost::hash<std::array<builtin_class,4>> > cache;
+    static ConcurrentCache<std::array<builtin_class,4>, coeff_class,
+                           boost::hash<std::array<builtin_class,4>> > cache;
 
     const std::array<builtin_class,4> params = {{a, b, c, x}};
-    if (cache.count(params) == 0) {
-        cache.emplace(params, HypergeometricPFQ_Reg<2,1>({{a,b}}, {{c}}, x));
-    }
-
-    return cache[params];
+    return cache.Get(params, [a, b, c, x]() {
+            return HypergeometricPFQ_Reg<2,1>({{a,b}}, {{c}}, x);
+        });
 }
 
 coeff_class Hypergeometric3F2(const builtin_class a1, const builtin_class a2,
@@ -58,10 +54,10 @@ coeff_class Hypergeometric3F2_Reg(const std::array<builtin_class,3>& a,
 }
 
 coeff_class Hypergeometric3F2_Reg(const std::array<builtin_class,6>& params) {
-    static std::unordered_map<std::array<builtin_class,6>,coeff_class,
-                          boost::hash<std::array<builtin_class,6>> > hgfrCache;
+    static ConcurrentCache<std::array<builtin_class,6>, coeff_class,
+                           boost::hash<std::array<builtin_class,6>> > hgfrCache;
 
-    if (hgfrCache.count(params) == 0) {
+    return hgfrCache.Get(params, [&params]() {
         coeff_class value;
         try {
             value = HypergeometricPFQ_Reg<3,2>({{params[0], params[1], 
@@ -78,10 +74,8 @@ coeff_class Hypergeometric3F2_Reg(const std::array<builtin_class,6>& params) {
         }
         // std::cout << "Hypergeometric3F2_Reg(" << params << ") = " <<  value 
             // << '\n';
-        hgfrCache.emplace(params, value);
-    }
-
-    return hgfrCache[params];
+        return value;
+    });
 }
 
 coeff_class Hypergeometric4F3(const builtin_class a1, const builtin_class a2,
@@ -98,10 +92,10 @@ coeff_class Hypergeometric4F3(const std::array<builtin_class,4>& a,
 }
 
 coeff_class Hypergeometric4F3(const std::array<builtin_class,8>& params) {
-    static std::unordered_map<std::array<builtin_class,8>,coeff_class,
-                          boost::hash<std::array<builtin_class,8>> > cache;
+    static ConcurrentCache<std::array<builtin_class,8>, coeff_class,
+                           boost::hash<std::array<builtin_class,8>> > cache;
 
-    if (cache.count(params) == 0) {
+    return cache.Get(params, [&params]() {
         coeff_class value;
         try {
             value = HypergeometricPFQ<4,3>({{params[0],   params[1], 
@@ -118,10 +112,8 @@ coeff_class Hypergeometric4F3(const std::array<builtin_class,8>& params) {
         }
         // std::cout << "Hypergeometric4F3(" << params << ") = " <<  value 
             // << '\n';
-        cache.emplace(params, value);
-    }
-
-    return cache[params];
+        return value;
+    });
 }
 
 coeff_class Hypergeometric4F3_Reg(const builtin_class a1, const builtin_class a2,
@@ -138,10 +130,10 @@ coeff_class Hypergeometric4F3_Reg(const std::array<builtin_class,4>& a,
 }
 
 coeff_class Hypergeometric4F3_Reg(const std::array<builtin_class,8>& params) {
-    static std::unordered_map<std::array<builtin_class,8>,coeff_class,
-                          boost::hash<std::array<builtin_class,8>> > cache;
+    static ConcurrentCache<std::array<builtin_class,8>, coeff_class,
+                           boost::hash<std::array<builtin_class,8>> > cache;
 
-    if (cache.count(params) == 0) {
+    return cache.Get(params, [&params]() {
         coeff_class value;
         try {
             value = HypergeometricPFQ_Reg<4,3>({{params[0],   params[1], 
@@ -159,8 +151,175 @@ coeff_class Hypergeometric4F3_Reg(const std::array<builtin_class,8>& params) {
         }
         // std::cout << "Hypergeometric4F3_Reg(" << params << ") = " <<  value 
             // << '\n';
-        cache.emplace(params, value);
+        return value;
+    });
+}
+
+namespace {
+
+// one thread's share of the counts; only that thread ever writes them, but 
+// they're atomic so that HypergeometricStats() can read them in the meantime
+struct ThreadCounts {
+    ThreadCounts();
+    ~ThreadCounts();
+
+    std::atomic<unsigned long long> series{0};
+    std::atomic<unsigned long long> terms{0};
+    std::atomic<unsigned long long> continued{0};
+    std::atomic<unsigned long long> transformed{0};
+};
+
+// the counts of the threads that are still running, plus the totals of the 
+// ones that have finished
+std::mutex countsMutex;
+std::vector<const ThreadCounts*> runningCounts;
+HypergeometricCounts finishedCounts;
+
+void AddCounts(HypergeometricCounts& total, const ThreadCounts& counts) {
+    total.series += counts.series.load(std::memory_order_relaxed);
+    total.terms += counts.terms.load(std::memory_order_relaxed);
+    total.continued += counts.continued.load(std::memory_order_relaxed);
+    total.transformed += counts.transformed.load(std::memory_order_relaxed);
+}
+
+ThreadCounts::ThreadCounts() {
+    std::lock_guard<std::mutex> lock(countsMutex);
+    runningCounts.push_back(this);
+}
+
+ThreadCounts::~ThreadCounts() {
+    std::lock_guard<std::mutex> lock(countsMutex);
+    AddCounts(finishedCounts, *this);
+    runningCounts.erase(std::find(runningCounts.begin(), runningCounts.end(), 
+                                  this));
+}
+
+// this thread is the only writer, so a plain load and store is enough; unlike
+// an atomic increment, it doesn't need the cache line to itself
+void Increase(std::atomic<unsigned long long>& count, 
+              const unsigned long long amount) {
+    count.store(count.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+} // anonymous namespace
+
+void CountHypergeometric(const HypergeometricCounts& counts) {
+    thread_local ThreadCounts threadCounts;
+    Increase(threadCounts.series, counts.series);
+    Increase(threadCounts.terms, counts.terms);
+    Increase(threadCounts.continued, counts.continued);
+    Increase(threadCounts.transformed, counts.transformed);
+}
+
+HypergeometricCounts HypergeometricStats() {
+    std::lock_guard<std::mutex> lock(countsMutex);
+    HypergeometricCounts total = finishedCounts;
+    for (const ThreadCounts* counts : runningCounts) AddCounts(total, *counts);
+    return total;
+}
+
+namespace {
+
+bool IsNonPosInt(const builtin_class x) {
+    return std::round(x) <= 0 && std::abs(std::round(x) - x) < EPSILON;
+}
+
+// 1/Gamma(x), which is 0 at the poles of Gamma
+coeff_class ReciprocalGamma(const builtin_class x) {
+    if (IsNonPosInt(x)) return 0;
+    return 1 / coeff_class(std::tgamma(x));
+}
+
+} // anonymous namespace
+
+// the formulas are DLMF 15.8.4 when c-a-b isn't an integer and 15.8.10 when it
+// is; both give series in 1-x, which converge quickly exactly where the 
+// ordinary one doesn't
+coeff_class Hypergeometric2F1_Reg_NearOne(const builtin_class a, 
+                                          const builtin_class b,
+                                          const builtin_class c, 
+                                          const builtin_class x) {
+    // polynomials are better off with their own (finite) series
+    if (IsNonPosInt(a) || IsNonPosInt(b)) return std::nan("");
+
+    const builtin_class m = c - a - b;
+    const builtin_class y = 1 - x;
+    const builtin_class mDistance = std::abs(m - std::round(m));
+    if (mDistance >= EPSILON && mDistance < 1e-3) {
+        // the two halves of 15.8.4 nearly cancel here, and 15.8.10 is wrong
+        return std::nan("");
+    }
+
+    if (mDistance >= EPSILON) {
+        coeff_class first = ReciprocalGamma(c - a) * ReciprocalGamma(c - b)
+            * HypergeometricPFQ_Reg<2,1>({{a, b}}, {{1 - m}}, y);
+        coeff_class second = ReciprocalGamma(a) * ReciprocalGamma(b) 
+            * std::pow(y, m)
+            * HypergeometricPFQ_Reg<2,1>({{c - a, c - b}}, {{1 + m}}, y);
+        HypergeometricCounts counts;
+        counts.transformed = 1;
+        CountHypergeometric(counts);
+        return M_PI / std::sin(M_PI*m) * (first - second);
+    }
+
+    const int mInt = std::round(m);
+    if (mInt < 0) {
+        // Euler's transformation turns c-a-b into a-b-c = -m > 0
+        coeff_class transformed = Hypergeometric2F1_Reg_NearOne(c - a, c - b, 
+                                                                c, x);
+        return std::pow(y, mInt) * transformed;
+    }
+
+    // the first, finite sum in 15.8.10
+    coeff_class finite = 0;
+    if (mInt > 0) {
+        coeff_class term = std::tgamma(mInt); // (m-1)!
+        for (int k = 0; k < mInt; ++k) {
+            finite += term;
+            if (k + 1 < mInt) {
+                term *= (a + k) * (b + k) * (x - 1);
+                term /= (k + 1.0) * (mInt - k - 1.0);
+            }
+        }
+        finite *= ReciprocalGamma(a + mInt) * ReciprocalGamma(b + mInt);
+    }
+
+    // the second, infinite sum, with the digammas updated by recurrence
+    const coeff_class logY = std::log(y);
+    coeff_class psiK = gsl_sf_psi(1);
+    coeff_class psiKM = gsl_sf_psi(mInt + 1);
+    coeff_class psiA = gsl_sf_psi(a + mInt);
+    coeff_class psiB = gsl_sf_psi(b + mInt);
+    coeff_class term = 1 / coeff_class(std::tgamma(mInt + 1));
+    coeff_class sum = 0;
+    coeff_class prev = 0;
+    int k = 0;
+    while (true) {
+        coeff_class next = term * (logY - psiK - psiKM + psiA + psiB);
+        sum += next;
+        if (std::abs<builtin_class>(prev/sum) < PRECISION_LIMIT
+                && std::abs<builtin_class>(next/sum) < PRECISION_LIMIT) {
+            break;
+        }
+        if (++k > ITERATION_LIMIT) {
+            throw std::runtime_error("Hypergeometric2F1_Reg_NearOne did not "
+                                     "converge.");
+        }
+        prev = next;
+        term *= (a + mInt + k - 1) * (b + mInt + k - 1) * y;
+        term /= coeff_class(k) * (k + mInt);
+        psiK += 1 / coeff_class(k);
+        psiKM += 1 / coeff_class(k + mInt);
+        psiA += 1 / coeff_class(a + mInt + k - 1);
+        psiB += 1 / coeff_class(b + mInt + k - 1);
     }
+    HypergeometricCounts counts;
+    counts.transformed = 1;
+    counts.terms = k + 1;
+    CountHypergeometric(counts);
 
-    return cache[params];
+    // (x-1)^m, with the sign written out since y^m is what's computed
+    coeff_class power = std::pow(y, mInt) * (mInt % 2 == 0 ? 1 : -1);
+    return finite - power * ReciprocalGamma(a) * ReciprocalGamma(b) * sum;
 }
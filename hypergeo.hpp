@@ -3,14 +3,20 @@
 
 #include <cmath>
 #include <array>
-#include <set>
+#include <vector>
+#include <algorithm> // std::find
 #include <unordered_map>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
 
 #include <boost/functional/hash.hpp>
+#include <gsl/gsl_sf_psi.h> // digamma for 2F1 near x = 1
 
 #include "constants.hpp"
 #include "io.hpp"
+#include "cache.hpp"
 
 // generalized hypergeometric function via templates. Also includes memoized
 // versions of 2F1, 3F2, and 4F3 in cpp file, but the templates are not memoized
@@ -25,6 +31,30 @@
 constexpr int ITERATION_LIMIT = 1e8;
 constexpr coeff_class PRECISION_LIMIT = 1e-10;
 
+// the plain series only converges like x^k, so above this argument 2F1 is 
+// computed from series in (1-x) instead and the other pFq with p = q+1 are 
+// continued from CONTINUATION_START along their differential equation
+constexpr builtin_class NEAR_ONE = 0.8;
+constexpr builtin_class CONTINUATION_START = 0.5;
+// each step of the continuation starts from the last one's result, so their
+// Taylor series are summed somewhat past PRECISION_LIMIT
+constexpr builtin_class CONTINUATION_LIMIT = 1e-12;
+
+// running totals over all of the series summed so far, for judging how well
+// the near-one methods are working. Each thread adds to its own totals, so 
+// that counting never contends between threads; HypergeometricStats() adds 
+// up every thread's totals as they stand when it's called
+struct HypergeometricCounts {
+    unsigned long long series = 0;      // summed term by term
+    unsigned long long terms = 0;       // in all of those series
+    unsigned long long continued = 0;   // pFqs continued toward 1
+    unsigned long long transformed = 0; // 2F1s done in terms of 1-x
+};
+HypergeometricCounts HypergeometricStats();
+// adds counts to the current thread's totals; this is meant to be called once
+// per function evaluated, not once per term
+void CountHypergeometric(const HypergeometricCounts& counts);
+
 // memoized functions for specific cases --------------------------------------
 
 coeff_class Hypergeometric2F1(const builtin_class a, const builtin_class b,
@@ -64,6 +94,13 @@ coeff_class Hypergeometric4F3_Reg(const std::array<builtin_class,4>& a,
                                   const builtin_class x);
 coeff_class Hypergeometric4F3_Reg(const std::array<builtin_class,8>& params);
 
+// analytic continuation of 2F1_Reg to series in 1-x; NaN if the parameters
+// are such that the ordinary series is better (e.g. it's a polynomial)
+coeff_class Hypergeometric2F1_Reg_NearOne(const builtin_class a, 
+                                          const builtin_class b,
+                                          const builtin_class c, 
+                                          const builtin_class x);
+
 // general templates ----------------------------------------------------------
 
 inline bool IsNegInt(const builtin_class x) {
@@ -85,32 +122,48 @@ coeff_class HypergeometricPFQ_Body(const std::array<builtin_class,P>& a,
     builtin_class k = 0.0; // k is the index of the most recent COMPLETED term
     int i = 0;
 
-    // if any a is a negative integer, all terms AFTER -a[i] will be 0
-    std::set<coeff_class> zeros;
+    // if any a is a negative integer, all terms AFTER -a[i] will be 0; this is
+    // called far too often to build sets, so the negative integers are kept in
+    // fixed-size arrays along with their smallest and largest values
+    std::array<coeff_class,P> zeros;
+    std::size_t numZeros = 0;
+    coeff_class firstZero = 0;
     for (std::size_t i = 0; i < P; ++i) {
         if (IsNegInt(a[i])) {
-            zeros.insert(std::round(-a[i]));
+            coeff_class zero = std::round(-a[i]);
+            if (numZeros == 0 || zero < firstZero) firstZero = zero;
+            zeros[numZeros++] = zero;
         }
     }
     // if any b is a negative integer, all terms BEFORE -b[i] will be 0
     // note: these are not actually divergences because PFQ is renormalized
-    std::set<coeff_class> divergences;
+    std::array<coeff_class,Q> divergences;
+    std::size_t numDivergences = 0;
+    coeff_class lastDivergence = 0;
     for (std::size_t i = 0; i < Q; ++i) {
         if (IsNegInt(b[i])) {
-            divergences.insert(std::round(-b[i]));
+            coeff_class divergence = std::round(-b[i]);
+            if (numDivergences == 0 || divergence > lastDivergence) {
+                lastDivergence = divergence;
+            }
+            divergences[numDivergences++] = divergence;
         }
     }
+    auto contains = [](const coeff_class* begin, const std::size_t count,
+                       const coeff_class value) {
+        return std::find(begin, begin + count, value) != begin + count;
+    };
 
-    if (divergences.size() > 0) {
+    if (numDivergences > 0) {
         // if there is a zero before the final divergence, all terms will be 0
-        if (zeros.size() > 0 && *zeros.begin() <= *divergences.rbegin()) {
+        if (numZeros > 0 && firstZero <= lastDivergence) {
             return 0;
         } else {
             // first nonzero term of regularized series
-            k = *divergences.rbegin() + 1;
+            k = lastDivergence + 1;
             del = std::pow(x, k) / std::tgamma(k+1);
             for (builtin_class a_i : a) {
-                if (zeros.count(a_i) == 0) {
+                if (!contains(zeros.data(), numZeros, a_i)) {
                     del *= std::tgamma(a_i + k) / std::tgamma(a_i);
                 } else {
                     coeff_class prod = 1;
@@ -120,7 +173,9 @@ coeff_class HypergeometricPFQ_Body(const std::array<builtin_class,P>& a,
                 }
             }
             for (builtin_class b_i : b) {
-                if (divergences.count(b_i) == 0) del /= std::tgamma(b_i + k);
+                if (!contains(divergences.data(), numDivergences, b_i)) {
+                    del /= std::tgamma(b_i + k);
+                }
             }
         }
     } else {
@@ -136,13 +191,18 @@ coeff_class HypergeometricPFQ_Body(const std::array<builtin_class,P>& a,
         sum_pos = del;
         del_pos = del;
     } else {
-        sum_neg = del;
-        del_neg = del;
+        sum_neg = -del;
+        del_neg = -del;
     }
 
+    HypergeometricCounts counts;
+    counts.series = 1;
+
     do {
         if(++i > ITERATION_LIMIT) {
             // return sum_pos - sum_neg;
+            counts.terms = i;
+            CountHypergeometric(counts);
             throw (std::runtime_error("HypergeometricPFQ_Reg did not converge."));
         }
         del_prev = del;
@@ -183,6 +243,8 @@ coeff_class HypergeometricPFQ_Body(const std::array<builtin_class,P>& a,
     } while(std::abs<builtin_class>((del_pos + del_neg)/(sum_pos-sum_neg)) 
             > PRECISION_LIMIT);
 
+    counts.terms = i;
+    CountHypergeometric(counts);
     return sum_pos - sum_neg;
 }
 
@@ -252,6 +314,10 @@ inline coeff_class HypergeoUnitArgument_Reg(
     }
 }
 
+template<std::size_t P, std::size_t Q>
+coeff_class HypergeometricPFQ_Reg(const std::array<builtin_class,P>& a,
+        const std::array<builtin_class,Q>& b, const builtin_class x);
+
 template<std::size_t P, std::size_t Q>
 coeff_class HypergeoSpecialCase_Reg(const std::array<builtin_class,P>& a,
         const std::array<builtin_class,Q>& b, const builtin_class x) {
@@ -306,13 +372,10 @@ coeff_class HypergeoSpecialCase_Reg(const std::array<builtin_class,P>& a,
                     }
                 }
 
-                coeff_class value = HypergeoSpecialCase_Reg<lowerP, 
-                                                            lowerQ>(a2, b2, x);
-                if (std::isnan(static_cast<builtin_class>(value))) {
-                    // the reduced one isn't a special case, so do series
-                    value = HypergeometricPFQ_Body<lowerP, lowerQ>(a2, b2, x);
-                }
-
+                // the reduced one may still be near x = 1, so it goes through
+                // the same steps as any other
+                coeff_class value = HypergeometricPFQ_Reg<lowerP,
+                                                          lowerQ>(a2, b2, x);
                 return value / std::tgamma(b[j]);
             }
         }
@@ -324,12 +387,230 @@ coeff_class HypergeoSpecialCase_Reg(const std::array<builtin_class,P>& a,
     return std::nan("");
 }
 
+// pFq with p = q+1 is singular at x = 1, and near there its series converges 
+// only like x^k while the usual stopping criterion underestimates the tail by
+// a factor of about 1/(1-x). Instead it's continued along the differential 
+// equation it satisfies,
+//      [theta Prod_j(theta + b_j - 1) - x Prod_i(theta + a_i)] F = 0,
+// where theta = x d/dx, from F and its first q derivatives at 
+// CONTINUATION_START, each Taylor series step going halfway to x = 1. That 
+// takes about log2(1/(1-x)) steps of a few dozen terms each. The starting 
+// values are only summed the first time they're needed, so a batch can share
+// them between all of its arguments
+template<std::size_t P, std::size_t Q>
+class HypergeometricContinuation {
+    public:
+        HypergeometricContinuation(const std::array<builtin_class,P>& a,
+                                   const std::array<builtin_class,Q>& b);
+
+        // NaN if p != q+1, the series is a polynomial, or x isn't past 
+        // CONTINUATION_START, since the ordinary series is better for those
+        coeff_class operator()(const builtin_class x);
+
+    private:
+        std::array<builtin_class,P> a;
+        std::array<builtin_class,Q> b;
+        bool applies;
+        // the equation divided by x is
+        //      Sum_{m=1}^P x^(m-1) (u[m] - v[m] x) F^(m) - v[0] F = 0
+        std::array<builtin_class,P+1> u;
+        std::array<builtin_class,P+1> v;
+        // F^(m)(CONTINUATION_START)/m!, once started is true
+        std::array<builtin_class,P> start;
+        bool started = false;
+};
+
+template<std::size_t P, std::size_t Q>
+HypergeometricContinuation<P,Q>::HypergeometricContinuation(
+        const std::array<builtin_class,P>& a, 
+        const std::array<builtin_class,Q>& b): a(a), b(b), applies(P == Q+1) {
+    for (builtin_class a_i : a) {
+        if (IsNegInt(a_i) || std::abs(a_i) < EPSILON) applies = false;
+    }
+    if (!applies) return;
+
+    // the two products as polynomials in theta, lowest power first
+    std::array<builtin_class,P+1> thetaU{};
+    std::array<builtin_class,P+1> thetaV{};
+    thetaU[1] = 1;
+    thetaV[0] = 1;
+    for (std::size_t j = 0; j < Q; ++j) {
+        for (std::size_t k = j + 2; k > 0; --k) {
+            thetaU[k] = thetaU[k-1] + (b[j] - 1)*thetaU[k];
+        }
+        thetaU[0] *= b[j] - 1;
+    }
+    for (std::size_t i = 0; i < P; ++i) {
+        for (std::size_t k = i + 1; k > 0; --k) {
+            thetaV[k] = thetaV[k-1] + a[i]*thetaV[k];
+        }
+        thetaV[0] *= a[i];
+    }
+
+    // theta^k = Sum_m S(k,m) x^m d^m/dx^m with S the Stirling numbers of the
+    // second kind, which are built up a row at a time
+    std::array<builtin_class,P+1> stirling{};
+    stirling[0] = 1;
+    u.fill(0);
+    v.fill(0);
+    for (std::size_t k = 0; k <= P; ++k) {
+        if (k > 0) {
+            for (std::size_t m = k; m > 0; --m) {
+                stirling[m] = m*stirling[m] + stirling[m-1];
+            }
+            stirling[0] = 0;
+        }
+        for (std::size_t m = 0; m <= k; ++m) {
+            u[m] += thetaU[k]*stirling[m];
+            v[m] += thetaV[k]*stirling[m];
+        }
+    }
+}
+
+template<std::size_t P, std::size_t Q>
+coeff_class HypergeometricContinuation<P,Q>::operator()(const builtin_class x) {
+    if (!applies || x <= CONTINUATION_START) return std::nan("");
+
+    if (!started) {
+        // d^m/dx^m pFq_Reg(a; b; x) = Prod_i (a_i)_m pFq_Reg(a+m; b+m; x)
+        std::array<builtin_class,P> aShifted = a;
+        std::array<builtin_class,Q> bShifted = b;
+        coeff_class factor = 1;
+        for (std::size_t m = 0; m < P; ++m) {
+            start[m] = factor * HypergeometricPFQ_Reg<P,Q>(aShifted, bShifted, 
+                                                           CONTINUATION_START);
+            for (builtin_class& a_i : aShifted) factor *= a_i++;
+            for (builtin_class& b_i : bShifted) ++b_i;
+            factor /= m + 1;
+        }
+        started = true;
+    }
+
+    // the steps are short enough that builtin_class doesn't lose anything 
+    // over the starting values' PRECISION_LIMIT, and it's much faster
+    std::array<builtin_class,P> taylor = start;
+    builtin_class center = CONTINUATION_START;
+    std::vector<builtin_class> scaled;
+    std::array<std::array<builtin_class,P+1>,P+1> coeffs;
+    HypergeometricCounts counts;
+    counts.continued = 1;
+    for (bool last = false; !last; ) {
+        last = x - center <= (1 - center)/2;
+        const builtin_class h = last ? x - center : (1 - center)/2;
+
+        // coeffs[m][l] is the coefficient of h^l in x^(m-1) (u[m] - v[m] x)
+        // expanded around center, times h^(l-m) since the Taylor coefficients
+        // are kept as scaled[n] = F^(n)(center) h^n / n!
+        for (std::size_t m = 1; m <= P; ++m) {
+            builtin_class choose = 1;     // (m choose l)
+            builtin_class chooseLess = 1; // (m-1 choose l)
+            for (std::size_t l = 0; l <= m; ++l) {
+                builtin_class coeff = -v[m]*choose*std::pow(center, m - l);
+                if (l < m) coeff += u[m]*chooseLess*std::pow(center, m - 1 - l);
+                coeffs[m][l] = coeff / std::pow(h, static_cast<int>(m - l));
+                choose *= (m - l) / (l + 1.0);
+                chooseLess *= (m - 1.0 - l) / (l + 1.0);
+            }
+        }
+
+        scaled.assign(taylor.begin(), taylor.end());
+        builtin_class hPower = 1;
+        for (std::size_t k = 0; k < P; ++k) {
+            scaled[k] *= hPower;
+            hPower *= h;
+        }
+
+        // next[k] sums up F^(k)(center + h) h^k / k! term by term
+        std::array<builtin_class,P> next{};
+        std::array<builtin_class,P> choose{}; // (n choose k)
+        int agreements = 0;
+        for (std::size_t n = 0; agreements < 2; ++n) {
+            if (n > ITERATION_LIMIT) {
+                throw std::runtime_error("HypergeometricContinuation did not "
+                                         "converge.");
+            }
+            // the coefficient of h^n in the equation gives scaled[n+P]; its 
+            // terms with m - l = d involve scaled[n+d] (n+d)!/(n+d-m)!
+            builtin_class rest = -v[0]*scaled[n];
+            for (std::size_t d = 0; d < P; ++d) {
+                builtin_class falling = 1;
+                builtin_class sum = 0;
+                for (std::size_t m = 1; m <= P; ++m) {
+                    falling *= static_cast<builtin_class>(n + d + 1) - m;
+                    if (m >= d && m - d <= n) sum += coeffs[m][m - d]*falling;
+                }
+                rest += sum*scaled[n + d];
+            }
+            builtin_class leading = coeffs[P][0];
+            for (std::size_t m = 0; m < P; ++m) leading *= n + P - m;
+            scaled.push_back(-rest / leading);
+            if (!std::isfinite(scaled.back())) {
+                throw std::runtime_error("HypergeometricContinuation did not "
+                                         "converge.");
+            }
+
+            bool converged = n >= P;
+            for (std::size_t k = 0; k < P; ++k) {
+                if (k == 0 || n == k) {
+                    choose[k] = 1;
+                } else if (n > k) {
+                    choose[k] *= n / (n - k + 0.0);
+                }
+                builtin_class term = choose[k]*scaled[n];
+                next[k] += term;
+                if (!(std::abs(term) <= CONTINUATION_LIMIT*std::abs(next[k]))) {
+                    converged = false;
+                }
+            }
+            agreements = converged ? agreements + 1 : 0;
+            ++counts.terms;
+        }
+
+        hPower = 1;
+        for (std::size_t k = 0; k < P; ++k) {
+            taylor[k] = next[k] / hPower;
+            hPower *= h;
+        }
+        center += h;
+    }
+
+    CountHypergeometric(counts);
+    return taylor[0];
+}
+
+// the methods for 0.8 < x < 1, any of which return NaN if they don't apply;
+// continuation is passed in so that a batch of these can share it
+template<std::size_t P, std::size_t Q>
+coeff_class HypergeometricPFQ_Reg_NearOne(const std::array<builtin_class,P>&,
+        const std::array<builtin_class,Q>&, const builtin_class x,
+        HypergeometricContinuation<P,Q>& continuation) {
+    return continuation(x);
+}
+
+template<>
+inline coeff_class HypergeometricPFQ_Reg_NearOne<2,1>(
+        const std::array<builtin_class,2>& a, 
+        const std::array<builtin_class,1>& b, const builtin_class x,
+        HypergeometricContinuation<2,1>& continuation) {
+    // 2F1 has a closed-form continuation, which is quicker when it works
+    coeff_class nearOne = Hypergeometric2F1_Reg_NearOne(a[0], a[1], b[0], x);
+    if (!std::isnan(static_cast<builtin_class>(nearOne))) return nearOne;
+    return continuation(x);
+}
+
 template<std::size_t P, std::size_t Q>
 coeff_class HypergeometricPFQ_Reg(const std::array<builtin_class,P>& a, 
         const std::array<builtin_class,Q>& b, const builtin_class x) {
     coeff_class specialCase = HypergeoSpecialCase_Reg<P,Q>(a, b, x);
     if (!std::isnan(static_cast<builtin_class>(specialCase))) return specialCase;
 
+    if (x > NEAR_ONE && x < 1) {
+        HypergeometricContinuation<P,Q> continuation(a, b);
+        coeff_class nearOne = HypergeometricPFQ_Reg_NearOne<P,Q>(a, b, x, 
+                                                                 continuation);
+        if (!std::isnan(static_cast<builtin_class>(nearOne))) return nearOne;
+    }
+
     return HypergeometricPFQ_Body<P,Q>(a, b, x);
 }
 
@@ -348,10 +629,119 @@ inline coeff_class HypergeometricPFQ_Reg<2,1>(const std::array<builtin_class,2>&
         coeff_class specialCase = HypergeoSpecialCase_Reg<2,1>(a, b, x);
         if (!std::isnan(static_cast<builtin_class>(specialCase))) return specialCase;
 
+        if (x > NEAR_ONE && x < 1) {
+            HypergeometricContinuation<2,1> continuation(a, b);
+            coeff_class nearOne = HypergeometricPFQ_Reg_NearOne<2,1>(a, b, x, 
+                                                                continuation);
+            if (!std::isnan(static_cast<builtin_class>(nearOne))) return nearOne;
+        }
+
         return HypergeometricPFQ_Body<2,1>(a, b, x);
     // }
 }
 
+// evaluate the same regularized pFq at every x in xs, putting the results in
+// out (resized to match xs). The series for the different arguments share 
+// their term ratios, so they're summed side by side with a single pass over 
+// the parameters per term, stopping once every one of them has converged. The 
+// arguments handled by special cases or the near-one methods, and all of them
+// if any b is a nonpositive integer, are done individually as usual, except 
+// that the near-one ones share the continuation's starting values. As with the
+// memoized wrappers, an argument whose series doesn't converge gets NaN (and a
+// message on cerr) without affecting the others.
+template<std::size_t P, std::size_t Q>
+void HypergeometricPFQ_Reg_Batch(const std::array<builtin_class,P>& a,
+                                 const std::array<builtin_class,Q>& b,
+                                 const std::vector<builtin_class>& xs,
+                                 std::vector<coeff_class>& out) {
+    out.resize(xs.size());
+
+    bool shared = true;
+    for (builtin_class b_i : b) {
+        if (std::abs(b_i) < EPSILON || IsNegInt(b_i)) shared = false;
+    }
+
+    auto notConverged = [&a, &b](const builtin_class x) {
+        std::cerr << "Error: " << P << 'F' << Q << "_Reg(" << a << "; " << b 
+            << "; " << x << ") did not converge.\n";
+        return coeff_class(std::nan(""));
+    };
+
+    // lanes[m] is the index into xs of the mth series being summed together
+    std::vector<std::size_t> lanes;
+    lanes.reserve(xs.size());
+    HypergeometricContinuation<P,Q> continuation(a, b);
+    for (std::size_t l = 0; l < xs.size(); ++l) {
+        try {
+            coeff_class specialCase = HypergeoSpecialCase_Reg<P,Q>(a, b, xs[l]);
+            if (!std::isnan(static_cast<builtin_class>(specialCase))) {
+                out[l] = specialCase;
+                continue;
+            }
+            if (xs[l] > NEAR_ONE && xs[l] < 1) {
+                coeff_class nearOne = HypergeometricPFQ_Reg_NearOne<P,Q>(a, b, 
+                        xs[l], continuation);
+                if (!std::isnan(static_cast<builtin_class>(nearOne))) {
+                    out[l] = nearOne;
+                    continue;
+                }
+            }
+            if (!shared || xs[l] > NEAR_ONE) {
+                out[l] = HypergeometricPFQ_Body<P,Q>(a, b, xs[l]);
+            } else {
+                lanes.push_back(l);
+            }
+        }
+        catch (const std::runtime_error& err) {
+            out[l] = notConverged(xs[l]);
+        }
+    }
+    if (lanes.empty()) return;
+
+    coeff_class first = 1;
+    for (builtin_class b_i : b) first /= std::tgamma(b_i);
+    std::vector<coeff_class> del(lanes.size(), first);
+    std::vector<coeff_class> sum(lanes.size(), first);
+    // positions in lanes of the series that haven't converged yet
+    std::vector<std::size_t> open(lanes.size());
+    for (std::size_t m = 0; m < open.size(); ++m) open[m] = m;
+
+    HypergeometricCounts counts;
+    counts.series = lanes.size();
+
+    for (int i = 1; !open.empty(); ++i) {
+        if (i > ITERATION_LIMIT) {
+            counts.terms += open.size() * static_cast<unsigned long long>(i);
+            for (std::size_t m : open) sum[m] = notConverged(xs[lanes[m]]);
+            break;
+        }
+        builtin_class k = i - 1;
+        coeff_class ratio = 1 / (k + 1.0);
+        for (coeff_class a_i : a) ratio *= (a_i + k);
+        for (coeff_class b_i : b) ratio /= (b_i + k);
+
+        for (std::size_t o = 0; o < open.size(); ) {
+            std::size_t m = open[o];
+            coeff_class del_prev = del[m];
+            del[m] *= ratio * xs[lanes[m]];
+            sum[m] += del[m];
+            // same stopping criterion as the body, including exact termination
+            if (del[m] == 0.0 || 
+                    (std::abs<builtin_class>(del_prev / sum[m]) < PRECISION_LIMIT
+                  && std::abs<builtin_class>(del[m] / sum[m]) < PRECISION_LIMIT)) {
+                counts.terms += i;
+                open[o] = open.back();
+                open.pop_back();
+            } else {
+                ++o;
+            }
+        }
+    }
+
+    CountHypergeometric(counts);
+    for (std::size_t m = 0; m < lanes.size(); ++m) out[lanes[m]] = sum[m];
+}
+
 template<std::size_t P, std::size_t Q>
 coeff_class HypergeometricPFQ(const std::array<builtin_class,P>& a, 
         const std::array<builtin_class,Q>& b, const builtin_class x) {
@@ -10,6 +10,7 @@
 #include <QtCore/QString>
 #endif
 #include "constants.hpp"
+#include "exponents.hpp"
 
 // stream output for particles
 inline std::ostream& operator<<(std::ostream& os, const particle& out) {
@@ -77,6 +78,18 @@ inline std::ostream& operator<<(std::ostream& os, const std::vector<char>& out){
     return os << static_cast<int>(out.back()) << " }";
 }
 
+// exponent lists are displayed exactly like vectors of chars
+inline std::ostream& operator<<(std::ostream& os, const ExponentVector& out) {
+    os << "{";
+    if (out.size() == 0) return os << " }";
+    for (std::size_t i = 0; i < out.size()-1; ++i) {
+        if (out[i] >= 0) os << " ";
+        os << static_cast<int>(out[i]) << ",";
+    }
+    if (out.back() >= 0) os << " ";
+    return os << static_cast<int>(out.back()) << " }";
+}
+
 // stream output for arrays
 template<typename T, std::size_t N>
 inline std::ostream& operator<<(std::ostream& os, const std::array<T,N>& out) {
@@ -0,0 +1,94 @@
+#ifndef KRONECKER_HPP
+#define KRONECKER_HPP
+
+#include <vector>
+#include <utility> // std::move
+#include <stdexcept>
+
+#include "constants.hpp"
+
+// An operator on the discretized states, whose index is (monomial or
+// polynomial) * partitions + (mu partition), written as a sum of Kronecker
+// products fock (x) mu. The direct operators are a single such term, a Fock
+// space matrix times their MuPart, and the interactions are one or two terms
+// for each distinct set of (alpha, r) exponents.
+//
+// The discretized polynomials are polysOnMinBasis (x) I, so changing to the
+// polynomial basis only has to be done to the Fock parts, which are tiny
+// compared to the full matrices: Project() does this, and Dense() then gives
+// the matrix that DiscretizePolys^T * Dense() * DiscretizePolys would have.
+
+class KroneckerSum {
+    public:
+        struct Term {
+            DMatrix fock;
+            DMatrix mu;
+        };
+
+        KroneckerSum(): KroneckerSum(0, 0, 0, 0) {}
+        KroneckerSum(const Eigen::Index fockRows, const Eigen::Index fockCols,
+                     const Eigen::Index muRows, const Eigen::Index muCols):
+            fockRows(fockRows), fockCols(fockCols), muRows(muRows),
+            muCols(muCols) {}
+
+        void AddTerm(DMatrix fock, DMatrix mu);
+        const std::vector<Term>& Terms() const { return terms; }
+
+        Eigen::Index rows() const { return fockRows*muRows; }
+        Eigen::Index cols() const { return fockCols*muCols; }
+
+        // the same operator between states given by the columns of polysA and
+        // polysB on the monomials: each fock becomes polysA^T * fock * polysB
+        KroneckerSum Project(const DMatrix& polysA, const DMatrix& polysB) const;
+        KroneckerSum Project(const DMatrix& polys) const {
+            return Project(polys, polys);
+        }
+
+        DMatrix Dense() const;
+
+    private:
+        Eigen::Index fockRows;
+        Eigen::Index fockCols;
+        Eigen::Index muRows;
+        Eigen::Index muCols;
+        std::vector<Term> terms;
+};
+
+inline void KroneckerSum::AddTerm(DMatrix fock, DMatrix mu) {
+    if (fock.rows() != fockRows || fock.cols() != fockCols
+            || mu.rows() != muRows || mu.cols() != muCols) {
+        throw std::logic_error(__FILE__ ": KroneckerSum::AddTerm given a term "
+                               "of the wrong dimensions");
+    }
+    terms.push_back({std::move(fock), std::move(mu)});
+}
+
+inline KroneckerSum KroneckerSum::Project(const DMatrix& polysA,
+                                          const DMatrix& polysB) const {
+    if (polysA.rows() != fockRows || polysB.rows() != fockCols) {
+        throw std::logic_error(__FILE__ ": KroneckerSum::Project given "
+                               "polynomials on a different basis");
+    }
+    KroneckerSum output(polysA.cols(), polysB.cols(), muRows, muCols);
+    output.terms.reserve(terms.size());
+    for (const auto& term : terms) {
+        output.terms.push_back({polysA.transpose()*term.fock*polysB, term.mu});
+    }
+    return output;
+}
+
+inline DMatrix KroneckerSum::Dense() const {
+    DMatrix output = DMatrix::Zero(rows(), cols());
+    for (const auto& term : terms) {
+        for (Eigen::Index j = 0; j < fockCols; ++j) {
+            for (Eigen::Index i = 0; i < fockRows; ++i) {
+                if (term.fock(i, j) == 0) continue;
+                output.block(i*muRows, j*muCols, muRows, muCols)
+                    += term.fock(i, j)*term.mu;
+            }
+        }
+    }
+    return output;
+}
+
+#endif
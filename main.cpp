@@ -77,6 +77,40 @@ Arguments ParseArguments(int argc, char* argv[]) {
 #endif
                     ret.options |= OPT_MATHEMATICA;
                     ++i; // next argument is the filename so don't process it
+                } else if (arg.size() > 1 && arg[1] == 'j') {
+                    // next argument is the number of threads to use
+                    if (i+1 >= argc || std::atoi(argv[i+1]) < 1) {
+                        throw std::runtime_error(__FILE__ ": -j must be "
+                                                 "followed by a positive number");
+                    }
+                    ret.threads = std::atoi(argv[i+1]);
+                    ++i; // next argument is the count so don't process it
+                } else if (arg.size() > 1 && arg[1] == 'x') {
+                    // next argument is the tolerance of the kernel interpolants
+                    if (i+1 >= argc || std::atof(argv[i+1]) <= 0) {
+                        throw std::runtime_error(__FILE__ ": -x must be "
+                                                 "followed by a positive "
+                                                 "tolerance");
+                    }
+                    ret.interpolation = std::atof(argv[i+1]);
+                    ++i; // next argument is the tolerance so don't process it
+                } else if (arg.size() > 1 && arg[1] == 'a') {
+                    // next argument is the tolerance of the adaptive integrals
+                    if (i+1 >= argc || std::atof(argv[i+1]) <= 0) {
+                        throw std::runtime_error(__FILE__ ": -a must be "
+                                                 "followed by a positive "
+                                                 "tolerance");
+                    }
+                    ret.cubature = std::atof(argv[i+1]);
+                    ++i; // next argument is the tolerance so don't process it
+                } else if (arg.size() > 1 && arg[1] == 'c') {
+                    // next argument is the directory of the element cache
+                    if (i+1 >= argc) {
+                        throw std::runtime_error(__FILE__ ": -c must be "
+                                                 "followed by a directory");
+                    }
+                    ret.cacheDir = argv[i+1];
+                    ++i; // next argument is the directory so don't process it
                 } else {
                     options.push_back(arg);
                 }
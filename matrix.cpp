@@ -24,62 +24,114 @@ DMatrix GramFock(const Basis<Mono>& basis) {
 // creates a gram matrix for the given basis using the Fock space inner product
 // 
 // this returns the rank 4 tensor relating states with different partitions
-DMatrix GramMatrix(const Basis<Mono>& basis, const std::size_t partitions) {
-    return MatrixInternal::Matrix(basis, partitions, MAT_INNER);
+DMatrix GramMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                   const unsigned int threads) {
+    return MatrixInternal::Matrix(basis, partitions, MAT_INNER, threads);
 }
 
 // creates a mass matrix M for the given monomials. To get the mass matrix of a 
 // basis of primary operators, one must express the primaries as a matrix of 
 // vectors, A, and multiply A^T M A.
-DMatrix MassMatrix(const Basis<Mono>& basis, const std::size_t partitions) {
-    return MatrixInternal::Matrix(basis, partitions, MAT_MASS);
+DMatrix MassMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                   const unsigned int threads) {
+    return MatrixInternal::Matrix(basis, partitions, MAT_MASS, threads);
 }
 
-DMatrix KineticMatrix(const Basis<Mono>& basis, const std::size_t partitions) {
-    return MatrixInternal::Matrix(basis, partitions, MAT_KINETIC);
+DMatrix KineticMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                      const unsigned int threads) {
+    return MatrixInternal::Matrix(basis, partitions, MAT_KINETIC, threads);
 }
 
 // creates a matrix of n->n interactions between the given basis's monomials
-DMatrix InteractionMatrix(const Basis<Mono>& basis, const std::size_t partitions) {
-    return MatrixInternal::Matrix(basis, partitions, MAT_INTER_SAME_N);
+DMatrix InteractionMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                          const unsigned int threads) {
+    return MatrixInternal::Matrix(basis, partitions, MAT_INTER_SAME_N, threads);
+}
+
+// the same matrices as above, but as a Fock part times a mu part; see 
+// kronecker.hpp. These are what the Hamiltonian is built from, since they can 
+// be moved to the polynomial basis without ever forming the full matrices
+KroneckerSum MassOperator(const Basis<Mono>& basis, const std::size_t partitions,
+                          const unsigned int threads) {
+    return MatrixInternal::Operator(basis, partitions, MAT_MASS, threads);
+}
+
+KroneckerSum KineticOperator(const Basis<Mono>& basis, 
+                             const std::size_t partitions,
+                             const unsigned int threads) {
+    return MatrixInternal::Operator(basis, partitions, MAT_KINETIC, threads);
+}
+
+KroneckerSum InteractionOperator(const Basis<Mono>& basis, 
+                                 const std::size_t partitions,
+                                 const unsigned int threads) {
+    return MatrixInternal::Operator(basis, partitions, MAT_INTER_SAME_N, 
+                                    threads);
+}
+
+KroneckerSum NPlus2Operator(const Basis<Mono>& basisA, 
+                            const Basis<Mono>& basisB,
+                            const std::size_t partitions, 
+                            const unsigned int threads) {
+    if (basisA.size() == 0 || basisB.size() == 0) return KroneckerSum();
+    std::size_t partitionsA = (basisA[0].NParticles() == 1 ? 1 : partitions);
+    std::size_t partitionsB = partitions;
+
+    MatrixInternal::PrecomputeMultinomials(basisA);
+    MatrixInternal::PrecomputeMultinomials(basisB);
+    using MatrixInternal::NtoN_Final;
+    std::vector<std::vector<NtoN_Final>> exponents(basisA.size(), 
+            std::vector<NtoN_Final>(basisB.size()));
+    FillRows(basisA.size(), threads, [&](const std::size_t i) {
+        for (std::size_t j = 0; j < basisB.size(); ++j) {
+            exponents[i][j] = MatrixInternal::NPlus2Exponents(basisA[i], 
+                                                              basisB[j]);
+        }
+    });
+
+    auto fockParts = MatrixInternal::FockPartsByExponents(exponents);
+    std::vector<std::array<char,2>> nrs;
+    for (const auto& fockPart : fockParts) nrs.push_back(fockPart.first);
+    PrecomputeMuPart_NPlus2(nrs, partitions, threads);
+
+    KroneckerSum output(basisA.size(), basisB.size(), partitionsA, partitionsB);
+    for (auto& fockPart : fockParts) {
+        output.AddTerm(std::move(fockPart.second), 
+                       MuPart_NPlus2(fockPart.first, partitions));
+    }
+    return output;
 }
 
 DMatrix NPlus2Matrix(const Basis<Mono>& basisA, const Basis<Mono>& basisB,
-                     const std::size_t partitions) {
+                     const std::size_t partitions, const unsigned int threads) {
     if (basisA.size() == 0 || basisB.size() == 0) return DMatrix(0, 0);
     std::size_t partitionsA = (basisA[0].NParticles() == 1 ? 1 : partitions);
     std::size_t partitionsB = partitions;
+    MatrixInternal::PrecomputeMultinomials(basisA);
+    MatrixInternal::PrecomputeMultinomials(basisB);
     DMatrix output(basisA.size()*partitionsA, basisB.size()*partitionsB);
-    for (std::size_t i = 0; i < basisA.size(); ++i) {
+    FillRows(basisA.size(), threads, [&](const std::size_t i) {
         for (std::size_t j = 0; j < basisB.size(); ++j) {
             output.block(i*partitionsA, j*partitionsB, partitionsA, partitionsB)
                 = MatrixInternal::MatrixBlock(basisA[i], basisB[j], 
                                               MAT_INTER_N_PLUS_2, partitions);
         }
-    }
+    });
     return output;
 }
 
 namespace MatrixInternal {
 
-// static hash tables for memoizing slow steps
+// static hash tables for memoizing slow steps; these are shared by all of the
+// threads spawned by FillRows()
 namespace {
     // all matrices: map from {x,y}->{u,yTilde}
-    std::unordered_map<std::string, std::vector<MatrixTerm_Intermediate>>
-        intermediateCache;
-    // direct matrices: map from {x,y}->{u,theta}
-    std::unordered_map<std::string, std::vector<MatrixTerm_Final>> directCache;
-    // interaction matrices: map from {x,y}->{u,r,theta}
-    std::unordered_map<std::string, std::vector<InteractionTerm_Step2>>
-        interactionCache;
-    // interaction n+2 matrices: map from {x,y}->{u,theta}
-    std::unordered_map<std::string, std::vector<MatrixTerm_Final>> nPlus2Cache;
-
-    // integrals: map from (a,b)->#
-    std::unordered_map<std::array<builtin_class,2>, builtin_class,
-            boost::hash<std::array<builtin_class,2>> > uPlusCache;
-    std::unordered_map<std::array<builtin_class,2>, builtin_class,
-            boost::hash<std::array<builtin_class,2>> > thetaCache;
+    ConcurrentCache<PackedKey, std::vector<MatrixTerm_Intermediate>,
+                    PackedKeyHash> intermediateCache;
+    // direct matrices: map from {x,y}->{u,theta}, and the same as a trie
+    ConcurrentCache<PackedKey, std::vector<MatrixTerm_Final>, PackedKeyHash>
+        directCache;
+    ConcurrentCache<PackedKey, TermTrie, PackedKeyHash> directTrieCache;
 } // anonymous namespace
 
 YTerm::YTerm(const coeff_class coeff, const std::string& y, 
@@ -124,8 +176,8 @@ MatrixTerm_Final::MatrixTerm_Final(const size_t n): coeff(1), uPlus(n),
 
 // maybe should be rvalue references instead? hopefully it's the same
 MatrixTerm_Final::MatrixTerm_Final(const coeff_class coeff, 
-		const std::vector<char>& uPlus, const std::vector<char>& uMinus, 
-		const std::vector<char>& sinTheta, const std::vector<char>& cosTheta): 
+		const ExponentVector& uPlus, const ExponentVector& uMinus, 
+		const ExponentVector& sinTheta, const ExponentVector& cosTheta): 
 	coeff(coeff), uPlus(uPlus), uMinus(uMinus), sinTheta(sinTheta), 
 	cosTheta(cosTheta) {
 }
@@ -150,37 +202,149 @@ std::ostream& operator<<(std::ostream& os, const NPlus2Term_Step2& out) {
 }
 
 // generically return direct or interaction matrix of the specified type
+//
+// the rows of the basis are spread over up to the given number of threads; each
+// entry is computed exactly as it would be serially, so the output doesn't 
+// depend on the thread count
 DMatrix Matrix(const Basis<Mono>& basis, const std::size_t kMax, 
-        const MATRIX_TYPE type) {
+        const MATRIX_TYPE type, const unsigned int threads) {
+    PrecomputeMultinomials(basis);
     // kMax == 0 means that the Fock part has been requested by itself
     if (kMax == 0) {
         DMatrix fockPart(basis.size(), basis.size());
-        for (std::size_t i = 0; i < basis.size(); ++i) {
+        FillRows(basis.size(), threads, [&](const std::size_t i) {
             fockPart(i, i) = MatrixTerm(basis[i], basis[i], type);
             for (std::size_t j = i+1; j < basis.size(); ++j) {
                 fockPart(i, j) = MatrixTerm(basis[i], basis[j], type);
                 fockPart(j, i) = fockPart(i, j);
             }
-        }
+        });
 
         return fockPart;
     } else {
+        // these operators are symmetric, so only the upper triangle of blocks
+        // is computed. Block (i,j) is MatrixBlock(i,j) + MatrixBlock(j,i)^T; 
+        // for the direct operators MatrixBlock(j,i) is MatrixBlock(i,j) (the 
+        // scalar part is symmetric and MuPart is symmetric, divided by 2), so 
+        // it isn't computed again. The interaction's MuPart_NtoN only covers 
+        // mu1 <= mu2, so there both orderings are still needed
         DMatrix output(basis.size()*kMax, basis.size()*kMax);
+        FillRows(basis.size(), threads, [&](const std::size_t i) {
+            for (std::size_t j = i; j < basis.size(); ++j) {
+                DMatrix block = MatrixBlock(basis[i], basis[j], type, kMax);
+                if (type == MAT_INTER_SAME_N && j != i) {
+                    output.block(i*kMax, j*kMax, kMax, kMax) = block 
+                        + MatrixBlock(basis[j], basis[i], type, kMax).transpose();
+                } else {
+                    output.block(i*kMax, j*kMax, kMax, kMax) 
+                        = block + block.transpose();
+                }
+            }
+        });
+        // mirror the upper triangle into the lower one
         for (std::size_t i = 0; i < basis.size(); ++i) {
+            for (std::size_t j = 0; j < i; ++j) {
+                output.block(i*kMax, j*kMax, kMax, kMax) 
+                    = output.block(j*kMax, i*kMax, kMax, kMax).transpose();
+            }
+        }
+        return output;
+    }
+}
+
+// the multinomial expansions of a monomial's y's only go up to its number of
+// particles and its degree, so filling the tables that far before the rows are
+// handed out to threads means that they only ever read them
+void PrecomputeMultinomials(const Basis<Mono>& basis) {
+    int particles = 0;
+    int degree = 0;
+    for (const Mono& mono : basis) {
+        particles = std::max<int>(particles, mono.NParticles());
+        degree = std::max(degree, mono.Degree());
+    }
+    Multinomial::Precompute(particles, degree);
+}
+
+// the matrix that Matrix(basis, kMax, type, threads) would return, as a sum of
+// Kronecker products. The direct operators are the Fock part times their 
+// MuPart, symmetrized as in Matrix; the interaction has a term C (x) M for each
+// set of exponents e, where C(i,j) is the coefficient of e in MatrixBlock(i,j) 
+// and M is MuPart_NtoN(e), plus the transpose of that term
+KroneckerSum Operator(const Basis<Mono>& basis, const std::size_t kMax, 
+                      const MATRIX_TYPE type, const unsigned int threads) {
+    if (basis.size() == 0) return KroneckerSum();
+    if (kMax == 0) {
+        throw std::logic_error(__FILE__ ": Operator needs at least 1 partition");
+    }
+
+    KroneckerSum output(basis.size(), basis.size(), kMax, kMax);
+    if (type == MAT_INTER_SAME_N) {
+        PrecomputeMultinomials(basis);
+        std::vector<std::vector<NtoN_Final>> exponents(basis.size(), 
+                std::vector<NtoN_Final>(basis.size()));
+        FillRows(basis.size(), threads, [&](const std::size_t i) {
             for (std::size_t j = 0; j < basis.size(); ++j) {
-                output.block(i*kMax, j*kMax, kMax, kMax)
-                    = MatrixBlock(basis[i], basis[j], type, kMax);
+                exponents[i][j] = InteractionExponents(basis[i], basis[j]);
             }
+        });
+        auto fockParts = FockPartsByExponents(exponents);
+        std::vector<std::array<char,2>> keys;
+        for (const auto& fockPart : fockParts) keys.push_back(fockPart.first);
+        PrecomputeMuPart_NtoN(basis[0].NParticles(), keys, kMax, threads);
+
+        for (auto& fockPart : fockParts) {
+            DMatrix muPart = MuPart_NtoN(basis[0].NParticles(), fockPart.first,
+                                         kMax);
+            DMatrix fockTranspose = fockPart.second.transpose();
+            DMatrix muTranspose = muPart.transpose();
+            output.AddTerm(std::move(fockPart.second), std::move(muPart));
+            output.AddTerm(std::move(fockTranspose), std::move(muTranspose));
         }
-        return output + output.transpose();
+    } else if (type == MAT_INTER_N_PLUS_2) {
+        throw std::logic_error(__FILE__ ": Operator can't do the n+2 "
+                               "interaction; use NPlus2Operator");
+    } else {
+        DMatrix muPart = (basis[0].NParticles() == 1 ? MuPart_1(type) 
+                                                     : MuPart(kMax, type));
+        output.AddTerm(Matrix(basis, 0, type, threads), 
+                       muPart + muPart.transpose());
     }
+    return output;
+}
+
+// collect the maps of exponents for each pair of monomials into one Fock space
+// matrix per set of exponents, in order of the exponents
+std::map<std::array<char,2>, DMatrix> FockPartsByExponents(
+        const std::vector<std::vector<NtoN_Final>>& exponents) {
+    std::map<std::array<char,2>, DMatrix> output;
+    const std::size_t rows = exponents.size();
+    const std::size_t cols = (rows == 0 ? 0 : exponents[0].size());
+    for (std::size_t i = 0; i < rows; ++i) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            for (const auto& term : exponents[i][j]) {
+                if (term.second == 0) continue;
+                auto iter = output.find(term.first);
+                if (iter == output.end()) {
+                    iter = output.emplace(term.first, 
+                                          DMatrix::Zero(rows, cols)).first;
+                }
+                iter->second(i, j) = term.second;
+            }
+        }
+    }
+    return output;
 }
 
 coeff_class MatrixTerm(const Mono& A, const Mono& B, const MATRIX_TYPE type) {
-    if (type == MAT_INNER || type == MAT_MASS) {
-        return MatrixTerm_Direct(A, B, type);
-    } else if (type == MAT_KINETIC) {
-        return MatrixTerm_Direct(A, B, MAT_INNER);
+    if (type == MAT_INNER || type == MAT_MASS || type == MAT_KINETIC) {
+        // the kinetic matrix has the same Fock part as the inner product
+        const MATRIX_TYPE fockType = (type == MAT_KINETIC ? MAT_INNER : type);
+        coeff_class output;
+        if (!ElementCache::Lookup(A, B, fockType, output)) {
+            output = MatrixTerm_Direct(A, B, fockType);
+            ElementCache::Store(A, B, fockType, output);
+        }
+        return output;
     } else if (type == MAT_INTER_N_PLUS_2) {
         throw std::logic_error("MatrixTerm: n-n+2 interaction can't be scalar");
     } else if (type == MAT_INTER_SAME_N) {
@@ -190,13 +354,29 @@ coeff_class MatrixTerm(const Mono& A, const Mono& B, const MATRIX_TYPE type) {
     }
 }
 
+namespace {
+// the terms in order of their exponents, so that the sums in MatrixBlock don't
+// depend on how the map happened to be filled (e.g. computed or read from disk)
+std::vector<std::pair<std::array<char,2>, coeff_class>> SortedTerms(
+        const NtoN_Final& terms) {
+    std::vector<std::pair<std::array<char,2>, coeff_class>> output(
+            terms.begin(), terms.end());
+    std::sort(output.begin(), output.end(), 
+              [](const std::pair<std::array<char,2>, coeff_class>& a,
+                 const std::pair<std::array<char,2>, coeff_class>& b) {
+                  return a.first < b.first;
+              });
+    return output;
+}
+} // anonymous namespace
+
 DMatrix MatrixBlock(const Mono& A, const Mono& B, const MATRIX_TYPE type,
         const std::size_t partitions) {
     if (type == MAT_INTER_SAME_N) {
-        NtoN_Final terms = MatrixTerm_NtoN(A, B);
+        NtoN_Final terms = InteractionExponents(A, B);
         DMatrix output = DMatrix::Zero(partitions, partitions);
         std::cout << "NtoN terms for " << A << " x " << B << ":\n";
-        for (auto& term : terms) {
+        for (auto& term : SortedTerms(terms)) {
             // if (!std::isfinite(static_cast<builtin_class>(newTerm.second))) {
                 // std::cerr << "Error: term (" << newTerm.first << ", " 
                     // << newTerm.second << ") is not finite." << std::endl;
@@ -209,26 +389,13 @@ DMatrix MatrixBlock(const Mono& A, const Mono& B, const MATRIX_TYPE type,
         }
         return output;
     } else if (type == MAT_INTER_N_PLUS_2) {
-        const char n = A.NParticles();
-        auto terms = MatrixTerm_NPlus2(A, B);
-        // algebraically add terms by r exponent before doing the discretization
-        std::unordered_map<std::array<char,2>, coeff_class, 
-                           boost::hash<std::array<char,2>> > addedTerms;
-        for (const auto& term : terms) {
-            std::array<char,2> key = {{static_cast<char>(n + 2*term.alpha), 
-                                                         term.r}};
-            if (addedTerms.count(key) == 0) {
-                addedTerms.emplace(key, term.coeff);
-            } else {
-                addedTerms[key] += term.coeff;
-            }
-        }
+        NtoN_Final addedTerms = NPlus2Exponents(A, B);
 
         std::size_t partitionsA = (A.NParticles() == 1 ? 1 : partitions);
         std::size_t partitionsB = partitions;
         DMatrix output = DMatrix::Zero(partitionsA, partitionsB);
         std::cout << "N+2 terms for " << A << " x " << B << ":\n";
-        for (const auto& term : addedTerms) {
+        for (const auto& term : SortedTerms(addedTerms)) {
             std::cout << term.second << " * " << term.first << '\n';
             if (term.second == 0) continue;
             output += term.second * MuPart_NPlus2(term.first, partitions);
@@ -243,6 +410,38 @@ DMatrix MatrixBlock(const Mono& A, const Mono& B, const MATRIX_TYPE type,
     }
 }
 
+// the n->n interaction between A and B before discretization, as a map from
+// (alpha, r) exponents to coefficients
+NtoN_Final InteractionExponents(const Mono& A, const Mono& B) {
+    NtoN_Final terms;
+    if (!ElementCache::Lookup(A, B, MAT_INTER_SAME_N, terms)) {
+        terms = MatrixTerm_NtoN(A, B);
+        ElementCache::Store(A, B, MAT_INTER_SAME_N, terms);
+    }
+    return terms;
+}
+
+// the same for the n->n+2 interaction, with the terms from MatrixTerm_NPlus2 
+// algebraically added by exponent
+NtoN_Final NPlus2Exponents(const Mono& A, const Mono& B) {
+    const char n = A.NParticles();
+    NtoN_Final addedTerms;
+    if (!ElementCache::Lookup(A, B, MAT_INTER_N_PLUS_2, addedTerms)) {
+        auto terms = MatrixTerm_NPlus2(A, B);
+        for (const auto& term : terms) {
+            std::array<char,2> key = {{static_cast<char>(n + 2*term.alpha), 
+                                                         term.r}};
+            if (addedTerms.count(key) == 0) {
+                addedTerms.emplace(key, term.coeff);
+            } else {
+                addedTerms[key] += term.coeff;
+            }
+        }
+        ElementCache::Store(A, B, MAT_INTER_N_PLUS_2, addedTerms);
+    }
+    return addedTerms;
+}
+
 coeff_class MatrixTerm_Direct(const Mono& A, const Mono& B, const MATRIX_TYPE type) {
     // std::cout << "TERM: " << A.HumanReadable() << " x " << B.HumanReadable() 
             // << std::endl;
@@ -258,21 +457,100 @@ coeff_class MatrixTerm_Direct(const Mono& A, const Mono& B, const MATRIX_TYPE ty
 
     std::string xAndy_A = ExtractXY(A);
     std::string xAndy_B = ExtractXY(B);
-    std::vector<MatrixTerm_Final> fFromA, fFromB, combinedFs;
 
+    // this is the sum over the permutations of FinalResult(CombineTwoFs(...)),
+    // but contracted one coordinate at a time instead of term by term. The 
+    // direct integrals are symmetric in all particles, so orderings of B which
+    // are related by a relabeling that leaves A alone are only done once
     coeff_class total = 0;
-    // do {
-    fFromA = DirectTermsFromXY(xAndy_A);
-    do {
-        fFromB = DirectTermsFromXY(xAndy_B);
-        combinedFs = CombineTwoFs(fFromA, fFromB);
-        total += FinalResult(combinedFs, type);
-    } while (PermuteXY(xAndy_B));
-    // } while (PermuteXY(xAndy_A));
+    for (const auto& orbit : PermutationOrbits(xAndy_A, xAndy_B, false, 
+                                               A.NParticles())) {
+        total += orbit.size * ContractDirect(DirectTrieFromXY(orbit.xAndy_A),
+                                             DirectTrieFromXY(orbit.xAndy_B), 
+                                             type);
+    }
 
     return prefactor*total;
 }
 
+// a list of terms in which terms whose exponents are all identical are merged
+// as they're added, by adding their coefficients, so that the integrals for 
+// each distinct set of exponents are done only once. The first occurrence of 
+// each set of exponents keeps its place in the list
+namespace {
+    std::size_t HashExponents(std::size_t seed, const ExponentVector& exps) {
+        boost::hash_range(seed, exps.begin(), exps.end());
+        // otherwise {1},{} and {},{1} would always collide
+        boost::hash_combine(seed, exps.size());
+        return seed;
+    }
+
+    std::size_t HashExponents(const InteractionTerm_Step2& term) {
+        std::size_t seed = HashExponents(0, term.u);
+        seed = HashExponents(seed, term.theta);
+        boost::hash_range(seed, term.r.begin(), term.r.end());
+        boost::hash_combine(seed, term.alpha);
+        return seed;
+    }
+
+    std::size_t HashExponents(const NPlus2Term_Step2& term) {
+        std::size_t seed = HashExponents(0, term.u);
+        seed = HashExponents(seed, term.theta);
+        boost::hash_combine(seed, term.r);
+        boost::hash_combine(seed, term.alpha);
+        return seed;
+    }
+
+    template<typename Term>
+    class LikeTerms {
+        public:
+            LikeTerms(): positions(0, Hash{terms}, Equal{terms}) {}
+            LikeTerms(const LikeTerms&) = delete;
+            LikeTerms& operator=(const LikeTerms&) = delete;
+
+            void Add(Term&& term) {
+                terms.push_back(std::move(term));
+                auto inserted = positions.insert(terms.size() - 1);
+                if (!inserted.second) {
+                    terms[*inserted.first].coeff += terms.back().coeff;
+                    terms.pop_back();
+                }
+            }
+
+            // the collected terms, without those whose coefficients cancelled
+            // exactly; this leaves the list empty
+            std::vector<Term> Collected() {
+                positions.clear();
+                terms.erase(std::remove_if(terms.begin(), terms.end(), 
+                            [](const Term& term) { return term.coeff == 0; }),
+                        terms.end());
+                return std::move(terms);
+            }
+
+        private:
+            // the set holds positions in the list, but hashes and compares the
+            // terms at those positions
+            struct Hash {
+                const std::vector<Term>& terms;
+                std::size_t operator()(const std::size_t i) const {
+                    return HashExponents(terms[i]);
+                }
+            };
+            struct Equal {
+                const std::vector<Term>& terms;
+                bool operator()(const std::size_t i, const std::size_t j) const {
+                    return terms[i].u == terms[j].u 
+                        && terms[i].theta == terms[j].theta
+                        && terms[i].r == terms[j].r 
+                        && terms[i].alpha == terms[j].alpha;
+                }
+            };
+
+            std::vector<Term> terms;
+            std::unordered_set<std::size_t, Hash, Equal> positions;
+    };
+} // anonymous namespace
+
 NtoN_Final MatrixTerm_NtoN(const Mono& A, const Mono& B) {
     //std::cout << "INTERACTION: " << A.HumanReadable() << " x " 
     //<< B.HumanReadable() << std::endl;
@@ -290,33 +568,25 @@ NtoN_Final MatrixTerm_NtoN(const Mono& A, const Mono& B) {
 
     std::string xAndy_A = ExtractXY(A);
     std::string xAndy_B = ExtractXY(B);
-    std::vector<MatrixTerm_Intermediate> fFromA, fFromB;
     std::vector<InteractionTerm_Step2> combinedFs;
-    NtoN_Final output;
-    do {
-        fFromA = InteractionTermsFromXY(xAndy_A);
-        do {
-            fFromB = InteractionTermsFromXY(xAndy_B);
-            combinedFs = CombineInteractionFs(fFromA, fFromB);
-
-            auto newTerms = InteractionOutput(combinedFs, prefactor);
-            for (const auto& newTerm : newTerms) {
-                // if (!std::isfinite(static_cast<builtin_class>(newTerm.second))) {
-                    // std::cerr << "Error: term (" << newTerm.first << ", " 
-                        // << newTerm.second << ") is not finite." << std::endl;
-                // }
-                if (output.count(newTerm.first) == 0) {
-                    output.insert(newTerm);
-                    // output.emplace(newTerm.first, newTerm.second);
-                } else {
-                    output[newTerm.first] += newTerm.second;
-                }
-            }
-            // output.insert(output.end(), newTerms.begin(), newTerms.end());
-        } while (PermuteXY(xAndy_B));
-    } while (PermuteXY(xAndy_A));
+    LikeTerms<InteractionTerm_Step2> allFs;
+    // collect like terms from all permutations before doing any integrals. 
+    // Only the last two particles of each side take part in the interaction,
+    // so orderings related by relabeling the other n-2 on both sides at once 
+    // are the same and are only done once, weighted by their number
+    std::size_t spectators = (A.NParticles() >= 2 ? A.NParticles() - 2 : 0);
+    for (const auto& orbit : PermutationOrbits(xAndy_A, xAndy_B, true, 
+                                               spectators)) {
+        const auto& fFromA = InteractionTermsFromXY(orbit.xAndy_A);
+        const auto& fFromB = InteractionTermsFromXY(orbit.xAndy_B);
+        combinedFs = CombineInteractionFs(fFromA, fFromB);
+        for (auto& term : combinedFs) {
+            term.coeff *= orbit.size;
+            allFs.Add(std::move(term));
+        }
+    }
     
-    return output;
+    return InteractionOutput(allFs.Collected(), prefactor);
 }
 
 std::vector<NPlus2Term_Output> MatrixTerm_NPlus2(const Mono& A, const Mono& B) {
@@ -338,20 +608,23 @@ std::vector<NPlus2Term_Output> MatrixTerm_NPlus2(const Mono& A, const Mono& B) {
 
     std::string xAndy_A = ExtractXY(A);
     std::string xAndy_B = ExtractXY(B);
-    std::vector<MatrixTerm_Intermediate> fFromA, fFromB;
     std::vector<NPlus2Term_Step2> combinedFs;
-    std::vector<NPlus2Term_Output> output;
-    do {
-        fFromA = InteractionTermsFromXY(xAndy_A);
-        do {
-            fFromB = InteractionTermsFromXY(xAndy_B);
-            combinedFs = CombineNPlus2Fs(fFromA, fFromB);
-            auto newTerms = NPlus2Output(combinedFs, prefactor);
-            output.insert(output.end(), newTerms.begin(), newTerms.end());
-        } while (PermuteXY(xAndy_B));
-    } while (PermuteXY(xAndy_A));
+    LikeTerms<NPlus2Term_Step2> allFs;
+    // as in MatrixTerm_NtoN; here the last particle of A becomes the last 3 of
+    // B, so the first n-1 particles of A (and B) are the spectators
+    for (const auto& orbit : PermutationOrbits(xAndy_A, xAndy_B, true,
+                                               A.NParticles() - 1)) {
+        const auto& fFromA = InteractionTermsFromXY(orbit.xAndy_A);
+        const auto& fFromB = InteractionTermsFromXY(orbit.xAndy_B);
+        combinedFs = CombineNPlus2Fs(fFromA, fFromB);
+        for (auto& term : combinedFs) {
+            term.coeff *= orbit.size;
+            allFs.Add(std::move(term));
+        }
+    }
     
-    return output;
+    std::vector<NPlus2Term_Step2> collected = allFs.Collected();
+    return NPlus2Output(collected, prefactor);
 }
 
 // custom std::next_permutation for xAndy using particle precedence
@@ -388,22 +661,26 @@ bool PermuteXY(std::string& xAndy) {
 
 const std::vector<MatrixTerm_Final>& DirectTermsFromXY(const std::string& xAndy)
 {
-    if (directCache.count(xAndy) == 0) {
-        // copy so we can break it in the next function
-        std::vector<MatrixTerm_Intermediate> intermediate 
-            = InteractionTermsFromXY(xAndy);
-        directCache.emplace(xAndy, ThetaFromYTilde(intermediate));
-    }
+    return directCache.Get(PackedKey(xAndy), [&xAndy]() {
+            // copy so we can break it in the next function
+            std::vector<MatrixTerm_Intermediate> intermediate 
+                = InteractionTermsFromXY(xAndy);
+            return ThetaFromYTilde(intermediate);
+        });
+}
 
-    return directCache[xAndy];
+const TermTrie& DirectTrieFromXY(const std::string& xAndy) {
+    return directTrieCache.Get(PackedKey(xAndy), [&xAndy]() {
+            return TermTrie(DirectTermsFromXY(xAndy));
+        });
 }
 
 const std::vector<MatrixTerm_Intermediate>& InteractionTermsFromXY(
         const std::string& xAndy) {
-    if (intermediateCache.count(xAndy) == 0) {
+    return intermediateCache.Get(PackedKey(xAndy), [&xAndy]() {
         std::string x(xAndy.begin(), xAndy.begin() + xAndy.size()/2);
         std::string y(xAndy.begin() + xAndy.size()/2, xAndy.end());
-        std::vector<char> uFromX(UFromX(x));
+        ExponentVector uFromX(UFromX(x));
         std::vector<MatrixTerm_Intermediate> terms(YTildeFromY(y));
         for (auto& term : terms) {
             if (term.uPlus.size() < uFromX.size()/2) {
@@ -417,10 +694,8 @@ const std::vector<MatrixTerm_Intermediate>& InteractionTermsFromXY(
                 // term.coeff *= std::pow(std::sqrt(2), term.uPlus[i] + term.uMinus[i]);
             }
         }
-        intermediateCache.emplace(xAndy, std::move(terms));
-    }
-
-    return intermediateCache[xAndy];
+        return terms;
+    });
 }
 
 // exponent transformations ---------------------------------------------------
@@ -440,12 +715,181 @@ std::string ExtractXY(const Mono& extractFromThis) {
     return xAndy;
 }
 
+namespace {
+// a particle's (x, y) exponents
+using XYParticle = std::array<char,2>;
+
+XYParticle ParticleXY(const std::string& xAndy, const std::size_t i) {
+    return {{xAndy[i], xAndy[xAndy.size()/2 + i]}};
+}
+
+// the distinct particles among positions [begin, end) of xAndy, in order, and
+// the number of times that each of them appears
+void CountParticles(const std::string& xAndy, const std::size_t begin, 
+                    const std::size_t end, std::vector<XYParticle>& particles,
+                    std::vector<unsigned int>& counts) {
+    std::map<XYParticle, unsigned int> found;
+    for (std::size_t i = begin; i < end; ++i) ++found[ParticleXY(xAndy, i)];
+    particles.clear();
+    counts.clear();
+    for (const auto& particle : found) {
+        particles.push_back(particle.first);
+        counts.push_back(particle.second);
+    }
+}
+
+// calls f(tail) for every distinct sequence of the given length which can be 
+// drawn from the particles with the given counts; tail holds their indices, 
+// and counts has the drawn particles removed while f runs
+template<typename F>
+void ForEachTail(std::vector<unsigned int>& counts, const std::size_t length,
+                 std::vector<std::size_t>& tail, F& f) {
+    if (tail.size() == length) {
+        f(tail);
+        return;
+    }
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] == 0) continue;
+        --counts[i];
+        tail.push_back(i);
+        ForEachTail(counts, length, tail, f);
+        tail.pop_back();
+        ++counts[i];
+    }
+}
+
+// calls f(table) for every table of non-negative integers, stored row by row,
+// whose rows and columns add up to the given sums; cell is the first entry not
+// yet filled in, and the sums are what remains for the unfilled entries
+template<typename F>
+void ForEachTable(std::vector<unsigned int>& rowSums, 
+                  std::vector<unsigned int>& colSums, 
+                  std::vector<unsigned int>& table, const std::size_t cell, 
+                  F& f) {
+    if (cell == table.size()) {
+        f(table);
+        return;
+    }
+    const std::size_t row = cell / colSums.size();
+    const std::size_t col = cell % colSums.size();
+    // the last entry of each row is whatever the row has left
+    unsigned int low = (col+1 == colSums.size() ? rowSums[row] : 0);
+    unsigned int high = std::min(rowSums[row], colSums[col]);
+    for (unsigned int entry = low; entry <= high; ++entry) {
+        table[cell] = entry;
+        rowSums[row] -= entry;
+        colSums[col] -= entry;
+        ForEachTable(rowSums, colSums, table, cell + 1, f);
+        rowSums[row] += entry;
+        colSums[col] += entry;
+    }
+}
+
+// the number of distinct orderings of the given numbers of identical objects
+std::uint64_t Arrangements(const unsigned int* counts, const std::size_t size) {
+    std::uint64_t output = 1;
+    unsigned int total = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        // output *= binomial(total + counts[i], counts[i]), one factor at once
+        for (unsigned int k = 1; k <= counts[i]; ++k) {
+            output = output * (++total) / k;
+        }
+    }
+    return output;
+}
+} // anonymous namespace
+
+// group all distinct orderings of B (and of A too, if permuteA) into orbits 
+// under relabeling the first "spectators" particles of A and B at the same 
+// time, without visiting the orderings one by one. An orbit is fixed by the 
+// particles after the spectators on each side (the "tails") and by how many 
+// spectators of each kind in A are paired with each kind in B; the latter is
+// a table whose rows and columns add up to the numbers of spectators of each
+// kind. Its size is the number of distinct ways of ordering the pairs.
+//
+// If permuteA, the representative of each orbit has its spectator pairs (A,B)
+// sorted. Otherwise only the spectators which are identical in A are 
+// relabeled, so A is left exactly as given; this matters because the number 
+// of terms from DirectTermsFromXY depends on the particle order
+std::vector<XYOrbit> PermutationOrbits(const std::string& xAndy_A, 
+        const std::string& xAndy_B, const bool permuteA, 
+        const std::size_t spectators) {
+    const std::size_t nA = xAndy_A.size()/2;
+    const std::size_t nB = xAndy_B.size()/2;
+    if (spectators > nA || spectators > nB) {
+        throw std::logic_error(__FILE__ ": PermutationOrbits given more "
+                               "spectators than particles");
+    }
+
+    std::vector<XYParticle> particlesA, particlesB;
+    std::vector<unsigned int> countsA, countsB;
+    CountParticles(xAndy_A, 0, permuteA ? nA : spectators, particlesA, countsA);
+    CountParticles(xAndy_B, 0, nB, particlesB, countsB);
+
+    // if A is kept, the spectators of each kind sit at these positions
+    std::vector<std::vector<std::size_t>> positionsA(particlesA.size());
+    if (!permuteA) {
+        for (std::size_t i = 0; i < spectators; ++i) {
+            auto kind = std::lower_bound(particlesA.begin(), particlesA.end(), 
+                                         ParticleXY(xAndy_A, i));
+            positionsA[kind - particlesA.begin()].push_back(i);
+        }
+    }
+
+    std::vector<XYOrbit> orbits;
+    std::vector<std::size_t> tailA, tailB;
+    std::vector<unsigned int> table(particlesA.size()*particlesB.size());
+    auto addOrbit = [&](const std::vector<unsigned int>& table) {
+        XYOrbit orbit{xAndy_A, xAndy_B, 1};
+        auto setParticle = [](std::string& xAndy, const std::size_t i, 
+                              const XYParticle& particle) {
+            xAndy[i] = particle[0];
+            xAndy[xAndy.size()/2 + i] = particle[1];
+        };
+        std::size_t position = 0;
+        for (std::size_t a = 0; a < particlesA.size(); ++a) {
+            const unsigned int* row = &table[a*particlesB.size()];
+            std::size_t inRow = 0;
+            for (std::size_t b = 0; b < particlesB.size(); ++b) {
+                for (unsigned int k = 0; k < row[b]; ++k, ++inRow) {
+                    std::size_t i = (permuteA ? position++ 
+                                              : positionsA[a][inRow]);
+                    if (permuteA) setParticle(orbit.xAndy_A, i, particlesA[a]);
+                    setParticle(orbit.xAndy_B, i, particlesB[b]);
+                }
+            }
+            if (!permuteA) orbit.size *= Arrangements(row, particlesB.size());
+        }
+        if (permuteA) orbit.size = Arrangements(table.data(), table.size());
+        for (std::size_t i = 0; i < tailA.size(); ++i) {
+            setParticle(orbit.xAndy_A, spectators + i, particlesA[tailA[i]]);
+        }
+        for (std::size_t i = 0; i < tailB.size(); ++i) {
+            setParticle(orbit.xAndy_B, spectators + i, particlesB[tailB[i]]);
+        }
+        orbits.push_back(std::move(orbit));
+    };
+    auto withTailB = [&](const std::vector<std::size_t>&) {
+        ForEachTable(countsA, countsB, table, 0, addOrbit);
+    };
+    auto withTailA = [&](const std::vector<std::size_t>&) {
+        ForEachTail(countsB, nB - spectators, tailB, withTailB);
+    };
+    if (permuteA) {
+        ForEachTail(countsA, nA - spectators, tailA, withTailA);
+    } else {
+        // A's tail is left where it is
+        withTailA(tailA);
+    }
+    return orbits;
+}
+
 // goes from x to u using Zuhair's (4.21); returned vector has a list of all u+ 
 // in order followed by a list of all u- in order
-std::vector<char> UFromX(const std::string& x) {
+ExponentVector UFromX(const std::string& x) {
     if (x.size() == 1) return {};
 
-    std::vector<char> u(2*x.size() - 2);
+    ExponentVector u(2*x.size() - 2);
     // the terms from x_1 through x_{n-1} are regular
     for (auto i = 0u; i < x.size()-1; ++i) {
         u[i] = 2*x[i];
@@ -606,12 +1050,12 @@ std::vector<MatrixTerm_Final> ThetaFromYTilde(
     for (auto& term : intermediateTerms) {
         if (term.yTilde.size() == 0) {
             ret.emplace_back(term.coeff, term.uPlus, term.uMinus, 
-                             std::vector<char>(), std::vector<char>());
+                             ExponentVector(), ExponentVector());
             continue;
         }
 
         // sine[i] appears in all yTilde[j] with j > i (strictly greater)
-        std::vector<char> sines(term.yTilde.size()-1, 0);
+        ExponentVector sines(term.yTilde.size()-1, 0);
         for (auto i = 0u; i < sines.size(); ++i) {
             for (auto j = i+1; j < term.yTilde.size(); ++j) {
                 sines[i] += term.yTilde[j];
@@ -649,6 +1093,163 @@ std::vector<MatrixTerm_Final> CombineTwoFs(const std::vector<MatrixTerm_Final>&
     return ret;
 }
 
+TermTrie::TermTrie(const std::vector<MatrixTerm_Final>& terms): nodes(1) {
+    if (terms.empty()) return;
+    uLevels = terms.front().uPlus.size();
+    const std::size_t thetaLevels = terms.front().sinTheta.size();
+    maxExponents.resize(uLevels + thetaLevels, {{0, 0}});
+
+    for (const auto& term : terms) {
+        if (term.uPlus.size() != uLevels || term.uMinus.size() != uLevels
+                || term.sinTheta.size() != thetaLevels 
+                || term.cosTheta.size() != thetaLevels) {
+            throw std::logic_error(__FILE__ ": TermTrie given terms of "
+                                   "different lengths");
+        }
+
+        std::size_t node = 0;
+        for (std::size_t level = 0; level < Levels(); ++level) {
+            std::array<char,2> key;
+            if (level < uLevels) {
+                key = {{term.uPlus[level], term.uMinus[level]}};
+            } else {
+                key = {{term.sinTheta[level - uLevels], 
+                        term.cosTheta[level - uLevels]}};
+            }
+            if (key[0] < 0 || key[1] < 0) {
+                throw std::logic_error(__FILE__ ": TermTrie given a negative "
+                                       "exponent");
+            }
+            maxExponents[level][0] = std::max(maxExponents[level][0], key[0]);
+            maxExponents[level][1] = std::max(maxExponents[level][1], key[1]);
+
+            std::size_t child = 0;
+            for (const auto& existing : nodes[node].children) {
+                if (existing.first == key) child = existing.second;
+            }
+            if (child == 0) {
+                child = nodes.size();
+                nodes[node].children.emplace_back(key, child);
+                // this may reallocate nodes, so nothing can be held by reference
+                nodes.emplace_back();
+            }
+            node = child;
+        }
+        nodes[node].coeff += term.coeff;
+    }
+}
+
+namespace {
+    // values of one level's integral for every possible sum of exponents from
+    // A and B; the mass matrix also needs the u integrals with the 1/x shift
+    // placed on this coordinate (u+ lowered by 2) or on a later one (u- lowered
+    // by 2), see FinalResult
+    struct LevelTable {
+        std::size_t width;
+        std::vector<builtin_class> plain;
+        std::vector<builtin_class> place;
+        std::vector<builtin_class> skip;
+
+        std::size_t Index(const std::array<char,2>& a, 
+                          const std::array<char,2>& b) const {
+            return (a[0] + b[0])*width + a[1] + b[1];
+        }
+    };
+
+    // returns the contraction of the subtrees below nodes a and b, starting 
+    // from the given level; for the mass matrix, entry 0 is the value when the
+    // 1/x hasn't been placed on any earlier coordinate and entry 1 is the value
+    // when it has. Only entry 1 is computed for the inner product
+    std::array<coeff_class,2> ContractNodes(const TermTrie& A, 
+            const std::size_t a, const TermTrie& B, const std::size_t b, 
+            const std::size_t level, const std::vector<LevelTable>& tables, 
+            const bool mass) {
+        const TermTrie::Node& nodeA = A.nodes[a];
+        const TermTrie::Node& nodeB = B.nodes[b];
+        if (level == A.Levels()) {
+            coeff_class leaf = nodeA.coeff * nodeB.coeff;
+            return {{leaf, leaf}};
+        }
+
+        const LevelTable& table = tables[level];
+        const bool uLevel = level < A.uLevels;
+        std::array<coeff_class,2> total{{0, 0}};
+        for (const auto& childA : nodeA.children) {
+            for (const auto& childB : nodeB.children) {
+                std::size_t index = table.Index(childA.first, childB.first);
+                std::array<coeff_class,2> below = ContractNodes(A, 
+                        childA.second, B, childB.second, level+1, tables, mass);
+                total[1] += table.plain[index]*below[1];
+                if (mass) {
+                    if (uLevel) {
+                        total[0] += table.place[index]*below[1] 
+                                  + table.skip[index]*below[0];
+                    } else {
+                        total[0] += table.plain[index]*below[0];
+                    }
+                }
+            }
+        }
+        return total;
+    }
+} // anonymous namespace
+
+// equivalent to FinalResult(CombineTwoFs(F1, F2), type) where A and B are the
+// tries of F1 and F2, but each level's integral is multiplied in once per pair
+// of subtrees rather than once per pair of terms
+coeff_class ContractDirect(const TermTrie& A, const TermTrie& B, 
+                           const MATRIX_TYPE type) {
+    if (type != MAT_INNER && type != MAT_MASS) {
+        throw std::logic_error(__FILE__ ": ContractDirect only does inner "
+                               "product and mass terms");
+    }
+    if (A.Levels() != B.Levels() || A.uLevels != B.uLevels) {
+        throw std::logic_error(__FILE__ ": ContractDirect given tries with "
+                               "different numbers of particles");
+    }
+    const bool mass = (type == MAT_MASS);
+    const std::size_t n = A.uLevels + 1;
+
+    std::vector<LevelTable> tables(A.Levels());
+    for (std::size_t level = 0; level < A.Levels(); ++level) {
+        LevelTable& table = tables[level];
+        const std::size_t height = A.maxExponents[level][0] 
+                                 + B.maxExponents[level][0] + 1;
+        table.width = A.maxExponents[level][1] + B.maxExponents[level][1] + 1;
+        table.plain.resize(height*table.width);
+        if (mass && level < A.uLevels) {
+            table.place.resize(height*table.width);
+            table.skip.resize(height*table.width);
+        }
+        for (std::size_t index = 0; index < table.plain.size(); ++index) {
+            const builtin_class p = index / table.width;
+            const builtin_class q = index % table.width;
+            // these are the same integrals as in DoAllIntegrals
+            if (level < A.uLevels) {
+                const builtin_class shift = 5*(n - (level+1)) - 2.0;
+                table.plain[index] = UPlusIntegral(p + 3, q + shift);
+                if (mass) {
+                    table.place[index] = UPlusIntegral(p + 1, q + shift);
+                    table.skip[index] = UPlusIntegral(p + 3, q - 2 + shift);
+                }
+            } else if (level+1 < A.Levels()) {
+                const builtin_class i = level - A.uLevels;
+                table.plain[index] = ThetaIntegral_Short(n - (i+1) - 2 + p, q);
+            } else {
+                table.plain[index] = ThetaIntegral_Long(p, q);
+            }
+        }
+    }
+
+    std::array<coeff_class,2> total = ContractNodes(A, 0, B, 0, 0, tables, mass);
+    // in DoAllIntegrals there are no thetas when n == 2, just a factor of 2
+    if (n == 2) {
+        total[0] *= 2;
+        total[1] *= 2;
+    }
+    return mass ? total[0] : total[1];
+}
+
 std::vector<InteractionTerm_Step2> CombineInteractionFs(
         const std::vector<MatrixTerm_Intermediate>& F1, 
         const std::vector<MatrixTerm_Intermediate>& F2) {
@@ -781,9 +1382,7 @@ NPlus2Term_Step2 CombineNPlus2Fs_OneTerm(
     return output;
 }
 
-// WARNING: if type == MAT_MASS this changes the MatrixTerm_Final vector by
-// by changing each term's uMinus entries by -2
-coeff_class FinalResult(std::vector<MatrixTerm_Final>& exponents,
+coeff_class FinalResult(const std::vector<MatrixTerm_Final>& exponents,
 		const MATRIX_TYPE type) {
     if (exponents.size() == 0) {
         // std::cerr << "No exponents detected; returning 1." << std::endl;
@@ -791,7 +1390,7 @@ coeff_class FinalResult(std::vector<MatrixTerm_Final>& exponents,
     }
     // auto n = exponents.front().uPlus.size() + 1;
     coeff_class totalFromIntegrals = 0;
-    for (auto& term : exponents) {
+    for (const auto& term : exponents) {
         if (term.uPlus.size() == 0) {
             totalFromIntegrals += 1;
             continue;
@@ -800,24 +1399,39 @@ coeff_class FinalResult(std::vector<MatrixTerm_Final>& exponents,
             // just do the integrals
             totalFromIntegrals += DoAllIntegrals(term);
         } else if (type == MAT_MASS) {
-            // sum over integral results for every possible 1/x
-            term.uPlus[0] -= 2;
-            totalFromIntegrals += DoAllIntegrals(term);
-            for (std::size_t i = 1; i < term.uPlus.size(); ++i) {
-                term.uPlus[i-1] += 2;
-                term.uMinus[i-1] -= 2;
-                term.uPlus[i] -= 2;
-                totalFromIntegrals += DoAllIntegrals(term);
+            // sum over integral results for every possible 1/x: the ith has 
+            // uPlus[i] lowered by 2 and uMinus[j] lowered by 2 for all j < i, 
+            // and the last has every uMinus lowered
+            MatrixTerm_Final shifted(term);
+            shifted.uPlus[0] -= 2;
+            totalFromIntegrals += DoAllIntegrals(shifted);
+            for (std::size_t i = 1; i < shifted.uPlus.size(); ++i) {
+                shifted.uPlus[i-1] += 2;
+                shifted.uMinus[i-1] -= 2;
+                shifted.uPlus[i] -= 2;
+                totalFromIntegrals += DoAllIntegrals(shifted);
             }
-            term.uPlus.back() += 2;
-            term.uMinus.back() -= 2;
-            totalFromIntegrals += DoAllIntegrals(term);
+            shifted.uPlus.back() += 2;
+            shifted.uMinus.back() -= 2;
+            totalFromIntegrals += DoAllIntegrals(shifted);
         }
     }
     //std::cout << "Returning FinalResult = " << totalFromIntegrals << std::endl;
     return totalFromIntegrals;
 }
 
+void CollectLikeTerms(std::vector<InteractionTerm_Step2>& terms) {
+    LikeTerms<InteractionTerm_Step2> collected;
+    for (auto& term : terms) collected.Add(std::move(term));
+    terms = collected.Collected();
+}
+
+void CollectLikeTerms(std::vector<NPlus2Term_Step2>& terms) {
+    LikeTerms<NPlus2Term_Step2> collected;
+    for (auto& term : terms) collected.Add(std::move(term));
+    terms = collected.Collected();
+}
+
 // do all of the integrals which are possible before mu discretization, and
 // return an object mapping {alpha and r exponents} -> value
 NtoN_Final InteractionOutput(const std::vector<InteractionTerm_Step2>& combinedFs, 
@@ -847,10 +1461,10 @@ NtoN_Final InteractionOutput(const std::vector<InteractionTerm_Step2>& combinedF
 // {alpha^2, r} to their coefficients (both represent a single monomial which is
 // the product of its constituent powers)
 const NtoN_Final& Expand(const std::array<char,3>& r, const char alpha) {
-    static std::unordered_map<std::array<char,4>, NtoN_Final,
-                              boost::hash<std::array<char,4>> > expansionCache;
+    static ConcurrentCache<std::array<char,4>, NtoN_Final,
+                           boost::hash<std::array<char,4>> > expansionCache;
     std::array<char,4> ra = {{r[0], r[1], r[2], alpha}};
-    if (expansionCache.count(ra) == 0) {
+    return expansionCache.Get(ra, [&r, alpha]() {
         NtoN_Final expansion;
 
         for (char mb = 0; mb <= r[1]/2; ++mb) {
@@ -872,10 +1486,8 @@ const NtoN_Final& Expand(const std::array<char,3>& r, const char alpha) {
                 // << std::endl;
         // }
 
-        expansionCache.emplace(ra, std::move(expansion));
-    }
-
-    return expansionCache[ra];
+        return expansion;
+    });
 }
 
 // do all of the integrals which are possible before mu discretization, and
@@ -911,16 +1523,14 @@ coeff_class Prefactor(const Mono& A, const Mono&, const MATRIX_TYPE type) {
 
 // this follows (2.2) in Matrix Formulas.pdf
 coeff_class InnerProductPrefactor(const char n) {
-    static std::unordered_map<char, coeff_class> cache;
-    if (cache.count(n) == 0) {
+    static ConcurrentCache<char, coeff_class> cache;
+    return cache.Get(n, [n]() {
         coeff_class denominator = std::tgamma(n+1); // tgamma = "true" gamma fcn
         denominator *= std::pow(8, n-1);
         denominator *= std::pow(M_PI, 2*n-3);
         //std::cout << "PREFACTOR: " << 1/denominator << std::endl;
-        cache.emplace(n, 1/denominator);
-    }
-
-    return cache[n];
+        return 1/denominator;
+    });
 }
 
 // this follows (2.3) in Matrix Formulas.pdf
@@ -935,28 +1545,24 @@ coeff_class MassMatrixPrefactor(const char n) {
 coeff_class InteractionMatrixPrefactor(const char n) {
     if (n == 1) return 0;
 
-    static std::unordered_map<char, coeff_class> cache;
-    if (cache.count(n) == 0) {
+    static ConcurrentCache<char, coeff_class> cache;
+    return cache.Get(n, [n]() {
         coeff_class denominator = std::tgamma(n-1);
         denominator *= std::pow(M_PI*M_PI, n-1);
         denominator *= std::pow(8, n);
-        cache.emplace(n, 1/denominator);
-    }
-
-    return cache[n];
+        return 1/denominator;
+    });
 }
 
 coeff_class NPlus2MatrixPrefactor(const char n) {
-    static std::unordered_map<char, coeff_class> cache;
-    if (cache.count(n) == 0) {
+    static ConcurrentCache<char, coeff_class> cache;
+    return cache.Get(n, [n]() {
         coeff_class denominator = std::tgamma(n);
         denominator *= 6;
         denominator *= std::pow(M_PI, 2*n);
         denominator *= std::pow(8, n+1);
-        cache.emplace(n, 1/denominator);
-    }
-
-    return cache[n];
+        return 1/denominator;
+    });
 }
 
 // integrals ------------------------------------------------------------------
@@ -1059,34 +1665,71 @@ coeff_class DoAllIntegrals_NPlus2(const NPlus2Term_Step2& term) {
     return output;
 }
 
-// this is the integral of uplus^a uminus^b dz instead of du
-builtin_class UPlusIntegral(const builtin_class a, const builtin_class b) {
-    std::array<builtin_class,2> abArray{{a,b}};
-    if (b < a) std::swap(abArray[0], abArray[1]);
-    if (uPlusCache.count(abArray) == 0) {
-        uPlusCache.emplace(abArray, gsl_sf_beta(a/2.0 + 1.0, b/2.0 + 1.0));
+// both the u and the theta integrals are Beta functions of half-integers, 
+// Beta((a+1)/2, (b+1)/2) for integers a and b which are built from char 
+// exponents. All of these up to BETA_TABLE_SIZE are put in one dense table the
+// first time it's needed, so each integral is just an array load
+namespace {
+constexpr int BETA_TABLE_SIZE = 256;
+
+// the table is filled using Beta(x+1,y) = Beta(x,y) * x/(x+y) starting from 
+// the four values with a and b each 0 or 1. These are all rational except for
+// a factor of pi when a and b are both even, which is put in at the end so that
+// the recurrence can be done exactly enough in coeff_class
+std::vector<builtin_class> MakeBetaTable() {
+    std::vector<coeff_class> rational(BETA_TABLE_SIZE*BETA_TABLE_SIZE);
+    std::vector<builtin_class> table(rational.size());
+    for (int a = 0; a < BETA_TABLE_SIZE; ++a) {
+        for (int b = 0; b < BETA_TABLE_SIZE; ++b) {
+            coeff_class& value = rational[a*BETA_TABLE_SIZE + b];
+            if (a >= 2) {
+                value = rational[(a-2)*BETA_TABLE_SIZE + b]*(a-1) / (a+b);
+            } else if (b >= 2) {
+                value = rational[a*BETA_TABLE_SIZE + b-2]*(b-1) / (a+b);
+            } else {
+                // Beta(1/2,1/2) = pi, Beta(1/2,1) = 2, Beta(1,1) = 1
+                value = (a == b ? 1 : 2);
+            }
+            table[a*BETA_TABLE_SIZE + b] = static_cast<builtin_class>(value)
+                * (a%2 == 0 && b%2 == 0 ? M_PI : 1);
+        }
     }
+    return table;
+}
 
-    return uPlusCache[abArray];
+// sets output to Beta((a+1)/2, (b+1)/2) and returns true if (a,b) is in the 
+// table; otherwise the caller has to compute it
+bool HalfIntegerBeta(const builtin_class a, const builtin_class b, 
+                     builtin_class& output) {
+    static const std::vector<builtin_class> table = MakeBetaTable();
+    if (a < 0 || b < 0 || a >= BETA_TABLE_SIZE || b >= BETA_TABLE_SIZE) {
+        return false;
+    }
+    const int intA = a;
+    const int intB = b;
+    if (intA != a || intB != b) return false;
+    output = table[intA*BETA_TABLE_SIZE + intB];
+    return true;
+}
+} // anonymous namespace
+
+// this is the integral of uplus^a uminus^b dz instead of du
+builtin_class UPlusIntegral(const builtin_class a, const builtin_class b) {
+    builtin_class output;
+    if (HalfIntegerBeta(a + 1, b + 1, output)) return output;
+    return gsl_sf_beta(a/2.0 + 1.0, b/2.0 + 1.0);
 }
 
 // this is the integral over the "theta" veriables from 0 to pi; it implements 
 // Zuhair's 5.35, where a is the exponent of sin(theta) and b is the exponent of 
 // cos(theta).
-//
-// results are cached by (a,b); since a and b are symmetric, we only store the
-// results with a <= b, swapping the two parameters if they're the other order
 builtin_class ThetaIntegral_Short(const builtin_class a, const builtin_class b) {
     if (std::abs(b - std::round(b)) < EPSILON && int(b)%2 == 1) return 0;
-    std::array<builtin_class,2> abArray{{a,b}};
-    if (b < a) std::swap(abArray[0], abArray[1]);
-    if (thetaCache.count(abArray) == 1) return thetaCache.at(abArray);
-
-    // builtin_class ret = std::exp(std::lgamma((1+a)/2) + std::lgamma((1+b)/2) 
+    builtin_class output;
+    if (HalfIntegerBeta(a, b, output)) return output;
+    // return std::exp(std::lgamma((1+a)/2) + std::lgamma((1+b)/2) 
                     // - std::lgamma((2 + a + b)/2) );
-    builtin_class ret = gsl_sf_beta((a+1.0)/2.0, (b+1.0)/2.0);
-    thetaCache.emplace(abArray, ret);
-    return ret;
+    return gsl_sf_beta((a+1.0)/2.0, (b+1.0)/2.0);
 }
 
 // this is the integral over the "theta" veriables from 0 to 2pi; it implements 
@@ -8,7 +8,12 @@
 #include <vector>
 #include <cmath>
 #include <unordered_map> // for caching integral results
+#include <unordered_set> // for collecting like terms
+#include <map>
 #include <algorithm> // std::remove_if
+#include <iterator> // std::make_move_iterator
+#include <functional> // std::function
+#include <cstdint> // std::uint64_t
 #include <gsl/gsl_sf_hyperg.h>
 #include <gsl/gsl_sf_gamma.h> // beta function
 #include <boost/functional/hash.hpp>
@@ -19,18 +24,41 @@
 #include "basis.hpp"
 #include "io.hpp"
 #include "discretization.hpp"
+#include "cache.hpp"
+#include "exponents.hpp"
+#include "element_cache.hpp"
+#include "kronecker.hpp"
+#include "parallel.hpp"
 
 // these should be the only functions you have to call from other files -------
 
 coeff_class InnerFock(const Mono& A, const Mono& B);
 DMatrix GramFock(const Basis<Mono>& basis);
 coeff_class InnerProduct(const Mono& A, const Mono& B);
-DMatrix GramMatrix(const Basis<Mono>& basis, const std::size_t partitions);
-DMatrix MassMatrix(const Basis<Mono>& basis, const std::size_t partitions);
-DMatrix KineticMatrix(const Basis<Mono>& basis, const std::size_t partitions);
-DMatrix InteractionMatrix(const Basis<Mono>& basis, const std::size_t partitions);
+DMatrix GramMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                   const unsigned int threads = 1);
+DMatrix MassMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                   const unsigned int threads = 1);
+DMatrix KineticMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                      const unsigned int threads = 1);
+DMatrix InteractionMatrix(const Basis<Mono>& basis, const std::size_t partitions,
+                          const unsigned int threads = 1);
 DMatrix NPlus2Matrix(const Basis<Mono>& basisA, const Basis<Mono>& basisB,
-                     const std::size_t partitions);
+                     const std::size_t partitions, 
+                     const unsigned int threads = 1);
+
+KroneckerSum MassOperator(const Basis<Mono>& basis, const std::size_t partitions,
+                          const unsigned int threads = 1);
+KroneckerSum KineticOperator(const Basis<Mono>& basis, 
+                             const std::size_t partitions,
+                             const unsigned int threads = 1);
+KroneckerSum InteractionOperator(const Basis<Mono>& basis, 
+                                 const std::size_t partitions,
+                                 const unsigned int threads = 1);
+KroneckerSum NPlus2Operator(const Basis<Mono>& basisA, 
+                            const Basis<Mono>& basisB,
+                            const std::size_t partitions, 
+                            const unsigned int threads = 1);
 
 // internal stuff -------------------------------------------------------------
 
@@ -42,10 +70,13 @@ using ::operator<<;
 
 // the main point of this header
 DMatrix Matrix(const Basis<Mono>& basis, const std::size_t partitions, 
-        const MATRIX_TYPE type);
+        const MATRIX_TYPE type, const unsigned int threads = 1);
 coeff_class MatrixTerm(const Mono& A, const Mono& B, const MATRIX_TYPE type);
 DMatrix MatrixBlock(const Mono& A, const Mono& B, const MATRIX_TYPE type,
         const std::size_t partitions);
+KroneckerSum Operator(const Basis<Mono>& basis, const std::size_t kMax, 
+                      const MATRIX_TYPE type, const unsigned int threads = 1);
+void PrecomputeMultinomials(const Basis<Mono>& basis);
 
 // five structs used in the coordinate transformations for MatrixTerm
 
@@ -64,9 +95,9 @@ std::ostream& operator<<(std::ostream& os, const YTerm& out);
 
 struct MatrixTerm_Intermediate {
     coeff_class coeff = 1;
-    std::vector<char> uPlus;
-    std::vector<char> uMinus;
-    std::vector<char> yTilde;
+    ExponentVector uPlus;
+    ExponentVector uMinus;
+    ExponentVector yTilde;
 
     MatrixTerm_Intermediate() = default;
     explicit MatrixTerm_Intermediate(const size_t n);
@@ -78,27 +109,48 @@ std::ostream& operator<<(std::ostream& os, const MatrixTerm_Intermediate& out);
 
 struct MatrixTerm_Final {
     coeff_class coeff = 1;
-    std::vector<char> uPlus;
-    std::vector<char> uMinus;
-    std::vector<char> sinTheta;
-    std::vector<char> cosTheta;
+    ExponentVector uPlus;
+    ExponentVector uMinus;
+    ExponentVector sinTheta;
+    ExponentVector cosTheta;
 
     MatrixTerm_Final() = default;
     explicit MatrixTerm_Final(const size_t n);
     // maybe should be rvalue references instead? hopefully it compiles the same
     MatrixTerm_Final(const coeff_class coeff, 
-                    const std::vector<char>& uPlus, const std::vector<char>& uMinus, 
-                    const std::vector<char>& sinTheta, const std::vector<char>& cosTheta);
+                    const ExponentVector& uPlus, const ExponentVector& uMinus, 
+                    const ExponentVector& sinTheta, const ExponentVector& cosTheta);
     void Resize(const size_t n);
 };
 
+// the terms of a direct F arranged as a trie with one level per coordinate: 
+// first the (u+, u-) pairs, then the (sin, cos) pairs of the thetas. Terms with
+// identical exponents share a leaf, whose coeff is the sum of theirs. Since
+// every integral in DoAllIntegrals only involves one coordinate, two of these
+// can be contracted level by level (see ContractDirect) rather than term by term
+struct TermTrie {
+    struct Node {
+        // the exponents of this level's coordinate and the index of the child
+        std::vector<std::pair<std::array<char,2>, std::size_t>> children;
+        coeff_class coeff = 0;
+    };
+
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::size_t uLevels = 0;
+    // largest exponents appearing on each level, used to size integral tables
+    std::vector<std::array<char,2>> maxExponents;
+
+    explicit TermTrie(const std::vector<MatrixTerm_Final>& terms);
+    std::size_t Levels() const { return maxExponents.size(); }
+};
+
 struct InteractionTerm_Step2 {
     // coeff(F1) * coeff(F2), not including degeneracies or coeffs of A&B (yet?)
     coeff_class coeff;
     // u1+, u1-, u2+, u2-, ... , u(n-1)+, u(n-1)-, u'(n-1)+, u'(n-1)-
-    std::vector<char> u;
+    ExponentVector u;
     // sin(theta_1), cos(theta_1), ... , sin(theta_(n-2)), cos(theta_(n-2))
-    std::vector<char> theta;
+    ExponentVector theta;
     // r, sqrt(1 - r^2), sqrt(1 - alpha^2 r^2)
     std::array<char,3> r;
     // the overall power of alpha derived from all yTilde' except the last one
@@ -116,17 +168,17 @@ struct InteractionTerm_Output {
         coeff(coeff), r(r) {}
 };
 
-typedef std::unordered_map<std::array<char,2>, coeff_class,
-                           boost::hash<std::array<char,2>> >NtoN_Final;
+// (alpha, r) exponents -> coefficient; also what ElementCache stores
+typedef ElementCache::ExponentMap NtoN_Final;
 
 struct NPlus2Term_Step2 {
     // coeff(F1) * coeff(F2), not including degeneracies or coeffs of A&B (yet?)
     coeff_class coeff;
     // u1+, u1-, u2+, u2-, ..., u(n-1)+, u(n-1)-, u'(n-1)+, u'(n-1)-, u'n+, u'n-
-    std::vector<char> u;
+    ExponentVector u;
     // sin(theta_1), cos(theta_1), ... , sin(theta_(n-2)), cos(theta_(n-2)),
     // sin(theta'), cos(theta')
-    std::vector<char> theta;
+    ExponentVector theta;
     // r, sqrt(1 - r^2), sqrt(1 - alpha^2 r^2)
     char r;
     char alpha;
@@ -145,6 +197,14 @@ struct NPlus2Term_Output {
         coeff(coeff), r(r), alpha(alpha) {}
 };
 
+// one orbit of orderings of a pair of monomials under relabelings that leave 
+// the matrix element unchanged: a representative pair and the orbit's size
+struct XYOrbit {
+    std::string xAndy_A;
+    std::string xAndy_B;
+    std::uint64_t size;
+};
+
 // the two functions for actually computing the two types of MatrixTerms:
 // direct for inner product and mass, inter for interactions
 coeff_class MatrixTerm_Direct(
@@ -152,14 +212,22 @@ coeff_class MatrixTerm_Direct(
 NtoN_Final MatrixTerm_NtoN(
         const Mono& A, const Mono& B);
 std::vector<NPlus2Term_Output> MatrixTerm_NPlus2(const Mono& A, const Mono& B);
+// the interactions' (alpha, r) exponent maps, via ElementCache if it's open
+NtoN_Final InteractionExponents(const Mono& A, const Mono& B);
+NtoN_Final NPlus2Exponents(const Mono& A, const Mono& B);
+std::map<std::array<char,2>, DMatrix> FockPartsByExponents(
+        const std::vector<std::vector<NtoN_Final>>& exponents);
 
 // coordinate transform functions, called from MatrixTerm
 std::string ExtractXY(const Mono& extractFromThis);
 bool PermuteXY(std::string& xAndy);
+std::vector<XYOrbit> PermutationOrbits(const std::string& xAndy_A, 
+        const std::string& xAndy_B, const bool permuteA, 
+        const std::size_t spectators);
 std::array<std::string,2> CombineXandY(const std::array<std::string,2>& xAndy_A,
 		std::array<std::string,2> xAndy_B);
 
-std::vector<char> UFromX(const std::string& x);
+ExponentVector UFromX(const std::string& x);
 std::vector<MatrixTerm_Final> ThetaFromY(const std::string y);
 std::vector<MatrixTerm_Intermediate> YTildeFromY(const std::string& y);
 std::vector<MatrixTerm_Final> ThetaFromYTilde(
@@ -181,10 +249,15 @@ coeff_class YTildeCoefficient(const char a, const char l,
 
 // functions specific to DIRECT computations
 const std::vector<MatrixTerm_Final>& DirectTermsFromXY(const std::string& xAndy);
+const TermTrie& DirectTrieFromXY(const std::string& xAndy);
+coeff_class ContractDirect(const TermTrie& A, const TermTrie& B, 
+                           const MATRIX_TYPE type);
 std::vector<MatrixTerm_Final> CombineTwoFs(const std::vector<MatrixTerm_Final>& F1,
 		const std::vector<MatrixTerm_Final>& F2);
-coeff_class FinalResult(std::vector<MatrixTerm_Final>& exponents,
+coeff_class FinalResult(const std::vector<MatrixTerm_Final>& exponents,
 		const MATRIX_TYPE type);
+void CollectLikeTerms(std::vector<InteractionTerm_Step2>& terms);
+void CollectLikeTerms(std::vector<NPlus2Term_Step2>& terms);
 
 // functions specific to INTERACTION computations
 const std::vector<MatrixTerm_Intermediate>& InteractionTermsFromXY(
@@ -1,19 +1,23 @@
 #include "mono.hpp"
 
 Mono::Mono(const std::vector<particle>& particles, const coeff_class& coeff): 
-    coeff(coeff), particles(particles) {
+    Mono() {
+    this->coeff = coeff;
+    Resize(particles.size());
+    std::copy(particles.begin(), particles.end(), this->particles.begin());
     Order();
 }
 
 Mono::Mono(const std::vector<int>& pm, const std::vector<int>& pt,
-		const coeff_class& coeff): coeff(coeff) {
+		const coeff_class& coeff): Mono() {
+    this->coeff = coeff;
     if(pm.size() != pt.size()){
         std::cerr << "Error: attempted to construct a monomial out of particle "
             << "data with different sizes: {" << pm.size() << "," << pt.size()
             << "}. It will be blank instead." << std::endl;
         return;
     }
-    particles.resize(pm.size());
+    Resize(pm.size());
     for(auto i = 0u; i < pm.size(); ++i){
         particles[i].pm = pm[i];
         particles[i].pt = pt[i];
@@ -21,6 +25,39 @@ Mono::Mono(const std::vector<int>& pm, const std::vector<int>& pt,
     Order();
 }
 
+void Mono::Resize(const std::size_t newCount) {
+    if (newCount > MAX_MONO_PARTICLES) {
+        throw std::length_error(__FILE__ ": asked for a monomial with "
+                + std::to_string(newCount) + " particles but Mono only holds "
+                + std::to_string(MAX_MONO_PARTICLES));
+    }
+    count = newCount;
+}
+
+// the particles past count are always left as zeros, so the whole array can be
+// hashed and compared as it is
+void Mono::UpdateStats() {
+    totalPm = 0;
+    totalPt = 0;
+    maxPt = -1;
+    for (std::size_t i = 0; i < count; ++i) {
+        totalPm += particles[i].pm;
+        totalPt += particles[i].pt;
+        maxPt = std::max(maxPt, particles[i].pt);
+    }
+
+    std::array<std::uint64_t, 4> words{{0, 0, 0, 0}};
+    static_assert(sizeof(particles) < sizeof(words), 
+                  "Mono's particles don't fit in its hashing words");
+    std::memcpy(words.data(), particles.data(), sizeof(particles));
+    hash = MixHash(count);
+    for (const std::uint64_t word : words) hash = MixHash(hash ^ word);
+}
+
+std::vector<particle> Mono::ParticleVector() const {
+    return std::vector<particle>(particles.begin(), particles.begin() + count);
+}
+
 const char& Mono::Pm(const int i) const {
     return particles[i].pm;
 }
@@ -51,16 +88,14 @@ void Mono::ChangePt(const int i, const char newValue) {
 
 // note: like all operations on completed Monos, this assumes both are ordered
 bool Mono::operator==(const Mono& other) const {
-    if(particles.size() != other.particles.size()){
+    if(count != other.count){
         std::cerr << "Error: asked to compare two monomials with different "
             << "numbers of particles." << std::endl;
         return false;
     }
-    for(unsigned int i = 0; i < particles.size(); ++i){
-        if(particles[i].pm != other.particles[i].pm
-                    || particles[i].pt != other.particles[i].pt) return false;
-    }
-    return true;
+    if(hash != other.hash) return false;
+    return std::memcmp(particles.data(), other.particles.data(), 
+                       sizeof(particles)) == 0;
 }
 
 std::ostream& operator<<(std::ostream& os, const Mono& out) {
@@ -70,9 +105,9 @@ std::ostream& operator<<(std::ostream& os, const Mono& out) {
 std::string MathematicaOutput(const Mono& out) {
     std::stringstream ss;
     if (std::abs<builtin_class>(out.coeff - 1) < EPSILON) {
-        ss << out.particles;
+        ss << out.ParticleVector();
     } else {
-        ss << out.coeff << " * " << out.particles;
+        ss << out.coeff << " * " << out.ParticleVector();
     }
     return ss.str();
 }
@@ -84,7 +119,8 @@ std::string Mono::HumanReadable() const {
     if(std::abs<builtin_class>(Coeff() - 1) > EPSILON) {
         os << std::abs<builtin_class>(Coeff()) << "*{";
     }
-    for(auto& p : particles) {
+    for(std::size_t i = 0; i < count; ++i) {
+        const particle& p = particles[i];
         if(p.pm != 0){
             os << "M";
             if(p.pm != 1) os << "^" << std::to_string(p.pm);
@@ -105,31 +141,12 @@ Mono Mono::operator-() const {
     return ret;
 }
 
-int Mono::TotalPm() const {
-    int total = 0;
-    for(auto& p : particles) total += p.pm;
-    return total;
-}
-
-int Mono::TotalPt() const {
-    int total = 0;
-    for(auto& p : particles) total += p.pt;
-    return total;
-}
-
 // if the Mono is ordered, particles[0] is guaranteed to have the highest Pm
 int Mono::MaxPm() const {
-    if(particles.size() < 1) return -1;
+    if(count < 1) return -1;
     return particles[0].pm;
 }
 
-// for this, we have to actually check
-int Mono::MaxPt() const {
-    int max = -1;
-    for(auto& p : particles) if(p.pt > max) max = p.pt;
-    return max;
-}
-
 // return a vector containing one entry per distinguishable particle in *this.
 // Each entry is the number of those particles contained.
 std::vector<size_t> Mono::CountIdentical() const {
@@ -173,7 +190,8 @@ bool Mono::ParticlePrecedence(const particle& a, const particle& b) {
 }
 
 void Mono::Order() {
-    std::sort(particles.begin(), particles.end(), ParticlePrecedence);
+    std::sort(particles.begin(), particles.begin() + count, ParticlePrecedence);
+    UpdateStats();
 }
 
 Mono Mono::OrderCopy() const {
@@ -183,7 +201,7 @@ Mono Mono::OrderCopy() const {
 }
 
 std::vector<int> Mono::IdentifyNodes() const {
-    return ::IdentifyNodes(particles);
+    return ::IdentifyNodes(ParticleVector());
 }
 
 std::vector<int> Mono::IdentifyPmNodes() const {
@@ -214,7 +232,7 @@ bool Mono::IsNull() const {
 
 // NOTE! These break ordering, so you have to re-order when you're done!
 Mono Mono::DerivPm(const unsigned int part) const {
-    if(part >= particles.size()){
+    if(part >= count){
         std::cerr << "Error: monomial told to take a derivative of momentum Pm["
             << part << "], but it only knows about " << NParticles() << "."
             << std::endl;
@@ -227,7 +245,7 @@ Mono Mono::DerivPm(const unsigned int part) const {
 }
 
 Mono Mono::DerivPt(const unsigned int part) const {
-    if(part >= particles.size()){
+    if(part >= count){
         std::cerr << "Error: monomial told to take a derivative of momentum Pt["
             << part << "], but it only knows about " << NParticles() << "."
             << std::endl;
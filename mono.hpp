@@ -7,9 +7,16 @@
 #include <ostream>
 #include <cmath>        // lgamma
 #include <algorithm>    // next_permutation
+#include <cstdint>      // std::uint64_t
+#include <cstring>      // std::memcmp
+#include <stdexcept>    // std::length_error
 
 #include "constants.hpp"
 #include "construction.hpp"
+#include "cache.hpp"    // MixHash
+
+// the same limit as ExponentVector's, which MatrixTerm needs for the exponents
+constexpr std::size_t MAX_MONO_PARTICLES = 14;
 
 // a mono(mial) with coefficient. It should be impossible for an instance of
 // this class to be out of order, so hopefully that's true! This class in its
@@ -28,9 +35,24 @@
 // * std::cout << someMono; will print the mono in this format:
 // coeff * {p1_m, p2_m, ... }{p1_t, p2_t, ...}. You may prefer
 // someMono.HumanReadable(), which more resembles how you'd write it on a board.
+// * The particles are stored inline (up to MAX_MONO_PARTICLES of them) instead
+// of in a vector, so copying a mono never allocates. The momenta can only be
+// changed through ChangePm and ChangePt, which reorder the mono, so Order() also
+// works out the totals, MaxPt, and a hash of the momenta and stores them: 
+// sorting and hashing monos doesn't go through the particles, and comparing
+// unequal monos almost never does.
 class Mono {
     coeff_class coeff;
-    std::vector<particle> particles;
+    std::uint64_t hash;
+    std::array<particle, MAX_MONO_PARTICLES> particles;
+    unsigned char count;
+    char maxPt;
+    short totalPm;
+    short totalPt;
+
+    void Resize(const std::size_t newCount);
+    void UpdateStats();
+    std::vector<particle> ParticleVector() const;
 
     std::vector<int> IdentifyNodes() const;
     template<typename T> std::vector<int> IdentifyNodes(T (*value)(particle)) const;
@@ -38,7 +60,7 @@ class Mono {
     std::vector<int> IdentifyPtNodes() const;
 
     public:
-        Mono(): coeff(1) {}
+        Mono(): coeff(1), particles{}, count(0) { UpdateStats(); }
         Mono(const std::vector<int>& pm, const std::vector<int>& pt, 
                         const coeff_class& coeff = 1);
         Mono(const std::vector<particle>& particles, 
@@ -47,7 +69,7 @@ class Mono {
         coeff_class& Coeff()		{ return coeff; }
         const coeff_class& Coeff() const	{ return coeff; }
 
-        unsigned int NParticles() const { return particles.size(); }
+        unsigned int NParticles() const { return count; }
 
         const char& Pm(const int i) const;
         //char& Pm(const int i);
@@ -55,11 +77,13 @@ class Mono {
         const char& Pt(const int i) const;
         //char& Pt(const int i);
         void ChangePt(const int i, const char newValue);
-        int TotalPm() const;
-        int TotalPt() const;
+        int TotalPm() const { return totalPm; }
+        int TotalPt() const { return totalPt; }
         int MaxPm() const;
-        int MaxPt() const;
-        int Degree() const { return TotalPm() + TotalPt(); }
+        int MaxPt() const { return maxPt; }
+        int Degree() const { return totalPm + totalPt; }
+        // depends only on the momenta, like operator==
+        std::uint64_t Hash() const { return hash; }
         std::vector<size_t> CountIdentical() const;
         std::vector<size_t> PermutationVector() const;
 
@@ -104,6 +128,10 @@ class Mono {
         Mono MultPp(const unsigned int targetParticle) const;
 };
 
+struct MonoHash {
+    std::uint64_t operator()(const Mono& mono) const { return mono.Hash(); }
+};
+
 // calls the generic IdentifyNodes using the class's particles and (*value)
 template<typename T>
 inline std::vector<int> Mono::IdentifyNodes(T (*value)(particle)) const{
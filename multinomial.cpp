@@ -3,199 +3,391 @@
 namespace Multinomial {
 
 namespace {
-    std::vector<std::unique_ptr<MultinomialTable>> multinomialTable;
-} // anonymous namespace
+    // The tables are shared by every thread and never change once they've been
+    // published here: a thread which needs a larger table copies the current 
+    // one, fills the copy, and swaps it in. Readers therefore only do an 
+    // atomic load, and growth is serialized by tableMutex. Tables which have 
+    // been replaced are kept in allTables (until Clear) because other threads 
+    // may still be reading them or holding MVectorRanges into them. To keep 
+    // that affordable, a table which has to be regrown at least doubles its 
+    // number of mVectors, so the replaced copies of it never add up to more 
+    // than the current one.
+    std::array<std::atomic<const MultinomialTable*>, MAX_TABLE_PARTICLES+1> 
+        publishedTables{};
+    std::mutex tableMutex;
+    std::vector<std::unique_ptr<MultinomialTable>> allTables;
+
+// compile-time tables ---------------------------------------------------------
+
+// Pascal's triangle, which stays exact all the way down since its entries are
+// below 2^64
+struct BinomialTable {
+    coeff_class values[BINOMIAL_DEGREE+1][BINOMIAL_DEGREE+1];
+};
+
+constexpr BinomialTable MakeBinomialTable() {
+    BinomialTable table{};
+    for (int n = 0; n <= BINOMIAL_DEGREE; ++n) {
+        table.values[n][0] = 1;
+        for (int m = 1; m <= n; ++m) {
+            table.values[n][m] = table.values[n-1][m-1] 
+                               + (m < n ? table.values[n-1][m] : 0);
+        }
+    }
+    return table;
+}
+
+constexpr BinomialTable binomials = MakeBinomialTable();
+
+// A multinomial coefficient only depends on the nonzero m's, so one table of
+// sorted mVectors with SMALL_PARTICLES entries covers every particle number up
+// to that, with the rest of the m's set to 0. The mVectors are ranked the same
+// way as in MultinomialTable: above[s][k][v] counts the partitions of s into at
+// most k parts whose first part is larger than v, and offsets[n] is the number
+// of partitions of totals below n.
+struct SmallPartitions {
+    std::uint32_t above[SMALL_DEGREE+1][SMALL_PARTICLES+1][SMALL_DEGREE+1];
+    std::uint32_t offsets[SMALL_DEGREE+2];
+};
+
+constexpr SmallPartitions MakeSmallPartitions() {
+    // counts[s][k][b] is the number of partitions of s into at most k parts 
+    // which are each at most b
+    struct {
+        std::uint32_t values[SMALL_DEGREE+1][SMALL_PARTICLES+1][SMALL_DEGREE+1];
+    } counts{};
+    SmallPartitions table{};
+    for (int s = 0; s <= SMALL_DEGREE; ++s) {
+        for (int k = 0; k <= SMALL_PARTICLES; ++k) {
+            for (int b = 0; b <= SMALL_DEGREE; ++b) {
+                if (s == 0) {
+                    counts.values[s][k][b] = 1;
+                } else if (k > 0 && b > 0) {
+                    counts.values[s][k][b] = counts.values[s][k][b-1]
+                        + (b <= s ? counts.values[s-b][k-1][b] : 0);
+                }
+            }
+            if (k == 0) continue;
+            for (int v = s-1; v >= 0; --v) {
+                table.above[s][k][v] = table.above[s][k][v+1] 
+                                     + counts.values[s-v-1][k-1][v+1];
+            }
+        }
+        table.offsets[s+1] = table.offsets[s] 
+                           + counts.values[s][SMALL_PARTICLES][s];
+    }
+    return table;
+}
+
+constexpr SmallPartitions smallPartitions = MakeSmallPartitions();
 
-constexpr bool MVectorPrecedence::operator()(const std::string& A, 
-                                             const std::string& B) const {
-    if (A.size() != B.size()) {
-        throw (std::runtime_error("MVectorPrecedence size mismatch: " + 
-                                  std::to_string(A.size()) + " vs " +
-                                  std::to_string(B.size())));
+constexpr std::size_t SMALL_TABLE_SIZE = smallPartitions.offsets[SMALL_DEGREE+1];
+
+struct SmallMultinomials {
+    coeff_class values[SMALL_TABLE_SIZE];
+};
+
+// goes through the partitions of each n in order (the first part as large as 
+// possible, then the second, etc.) and takes n!/(m_1! m_2! ...) of each
+constexpr SmallMultinomials MakeSmallMultinomials() {
+    SmallMultinomials table{};
+    std::size_t index = 0;
+    for (int n = 0; n <= SMALL_DEGREE; ++n) {
+        int m[SMALL_PARTICLES] = {};
+        m[0] = n;
+        while (true) {
+            coeff_class value = Factorial(n);
+            // the parts are in decreasing order, so the 0! at the end can go
+            for (int i = 0; i < SMALL_PARTICLES && m[i] > 0; ++i) {
+                value /= Factorial(m[i]);
+            }
+            table.values[index++] = value;
+
+            // the next partition lowers the rightmost part which can go down
+            // by 1, then packs everything after it into parts which are as 
+            // large as possible (but no larger than the lowered one)
+            int i = SMALL_PARTICLES - 1;
+            int rest = 0;
+            while (i >= 0 && (m[i] < 2 
+                        || (m[i]-1)*(SMALL_PARTICLES-1-i) < rest + 1)) {
+                rest += m[i];
+                --i;
+            }
+            if (i < 0) break;
+            --m[i];
+            ++rest;
+            for (int j = i+1; j < SMALL_PARTICLES; ++j) {
+                m[j] = rest < m[i] ? rest : m[i];
+                rest -= m[j];
+            }
+        }
     }
-    if (A.size() < 2 || B.size() < 2) {
-        throw (std::runtime_error("MVectorPrecedence argument(s) too short."));
+    return table;
+}
+
+constexpr SmallMultinomials smallMultinomials = MakeSmallMultinomials();
+
+// the coefficient of n and the count given m's (in any order) if they're in the
+// compile-time table; false if they're not, or if they don't add up to n
+bool SmallMultinomial(const char n, const char* m, const int count,
+                      coeff_class& coefficient) {
+    if (count > SMALL_PARTICLES || n < 0 || n > SMALL_DEGREE) return false;
+
+    char sorted[SMALL_PARTICLES] = {};
+    int total = 0;
+    for (int i = 0; i < count; ++i) {
+        if (m[i] < 0) return false;
+        total += m[i];
+        // insertion sort, largest first
+        int j = i;
+        for (; j > 0 && sorted[j-1] < m[i]; --j) sorted[j] = sorted[j-1];
+        sorted[j] = m[i];
     }
-    if (A[0] != B[0]) return A[0] < B[0];
-    for (auto i = 1u; i < A.size(); ++i) {
-        if (A[i] != B[i]) return A[i] > B[i];
+    if (total != n) return false;
+
+    int s = n;
+    int bound = n;
+    std::size_t index = smallPartitions.offsets[s];
+    for (int i = 0; i < count && s > 0; ++i) {
+        const int k = SMALL_PARTICLES - i;
+        index += smallPartitions.above[s][k][static_cast<int>(sorted[i])]
+               - smallPartitions.above[s][k][std::min(bound, s)];
+        s -= sorted[i];
+        bound = sorted[i];
     }
-    return false;
+    coefficient = smallMultinomials.values[index];
+    return true;
 }
 
+} // anonymous namespace
+
 void Initialize(const char particleNumber, const char highestN) {
-    if (multinomialTable.size() <= static_cast<std::size_t>(particleNumber)) {
-        multinomialTable.resize(particleNumber+1);
+    if (particleNumber < 0 || particleNumber > MAX_TABLE_PARTICLES) {
+        throw std::out_of_range(__FILE__ ": asked for a multinomial table with "
+                + std::to_string(particleNumber) + " particles, but they only "
+                "go up to " + std::to_string(MAX_TABLE_PARTICLES));
     }
-    if (multinomialTable[particleNumber] == nullptr) {
-        multinomialTable[particleNumber] = 
-                            std::make_unique<MultinomialTable>(particleNumber);
+    auto& published = publishedTables[particleNumber];
+
+    std::lock_guard<std::mutex> lock(tableMutex);
+    // another thread may have grown the table while this one was waiting
+    const MultinomialTable* current = published.load(std::memory_order_acquire);
+    if (current != nullptr && current->HighestN() >= highestN) return;
+
+    std::unique_ptr<MultinomialTable> grown = current == nullptr 
+        ? std::make_unique<MultinomialTable>(particleNumber)
+        : std::make_unique<MultinomialTable>(*current);
+    grown->FillTo(highestN);
+    if (current != nullptr && particleNumber > 0) {
+        while (grown->Size() < 2*current->Size() 
+                && grown->HighestN() < std::numeric_limits<char>::max()) {
+            grown->FillTo(grown->HighestN() + 1);
+        }
     }
-    /*if (particleNumber >= 2)*/ multinomialTable[particleNumber]->FillTo(highestN);
+    published.store(grown.get(), std::memory_order_release);
+    allTables.push_back(std::move(grown));
 }
 
+// fill the tables for 1 to maxParticles to maxDegree, so that a parallel 
+// calculation which stays within those never has to grow (or lock) them
+void Precompute(const char maxParticles, const char maxDegree) {
+    for (char particleNumber = 1; particleNumber <= maxParticles; 
+            ++particleNumber) {
+        Initialize(particleNumber, maxDegree);
+    }
+}
+
+// only safe when no other thread is using the tables, since this destroys them
 void Clear() {
-    multinomialTable.clear();
+    std::lock_guard<std::mutex> lock(tableMutex);
+    for (auto& published : publishedTables) published.store(nullptr);
+    allTables.clear();
 }
 
-std::unique_ptr<MultinomialTable>& GetTable(const std::size_t n, const char d) {
-    if (multinomialTable.size() < n+1 
-        || multinomialTable[n] == nullptr
-        || multinomialTable[n]->HighestN() < d) {
-        // throw std::logic_error("GetMVectors called on uninitialized pNumber.");
+const MultinomialTable* GetTable(const std::size_t n, const char d) {
+    if (n >= publishedTables.size()) {
+        throw std::out_of_range(__FILE__ ": asked for a multinomial table with "
+                + std::to_string(n) + " particles");
+    }
+    const MultinomialTable* table 
+        = publishedTables[n].load(std::memory_order_acquire);
+    if (table == nullptr || table->HighestN() < d) {
         Initialize(n, d);
+        table = publishedTables[n].load(std::memory_order_acquire);
     }
-    return multinomialTable[n];
+    return table;
 }
 
-// vector of all mVectors whose total "n" is exactly the supplied n
-//
-// if this turns out to be slow, we can avoid the copy by passing iterators to
-// a slightly reorganized container for the mVectors
-MVectorContainer GetMVectors(const unsigned char particleNumber, const char n) {
+// all mVectors whose total "n" is exactly the supplied n
+MVectorRange GetMVectors(const unsigned char particleNumber, const char n) {
     return GetTable(particleNumber, n)->GetMVectors(n);
 }
 
 // binomial coefficient (n, m)
 coeff_class Choose(const char n, const char m) {
-    // FIXME? if this is slow, special case for binomial without vector overhead
+    if (m < 0 || m > n) return 0;
+    if (n <= BINOMIAL_DEGREE) {
+        return binomials.values[static_cast<int>(n)][static_cast<int>(m)];
+    }
     return GetTable(2, n)->Lookup(std::string({{n, static_cast<char>(n-m), m}}));
 }
 
 // multinomial coefficient (n, \vec m)
 coeff_class Choose(const char particleNumber, const char n, 
                    const std::vector<char>& m) {
+    coeff_class coefficient;
+    if (m.size() == static_cast<std::size_t>(particleNumber)
+            && SmallMultinomial(n, m.data(), m.size(), coefficient)) {
+        return coefficient;
+    }
     return GetTable(particleNumber, n)->Choose(n, m);
 }
 
 coeff_class Lookup(const char particleNumber, const std::string& nAndm) {
+    coeff_class coefficient;
+    if (nAndm.size() == particleNumber + 1u
+            && SmallMultinomial(nAndm[0], nAndm.data() + 1, particleNumber, 
+                                coefficient)) {
+        return coefficient;
+    }
     return GetTable(particleNumber, nAndm[0])->Lookup(nAndm);
 }
 
-/*void FillTo(const char particleNumber, const char newHighestN) {
-    if (GetTable(particleNumber, newHighestN) == nullptr) {
-        std::cerr << "Error: asked to fill a nullptr MultinomialTable to n="
-            << std::to_string(newHighestN) << "." << std::endl;
-        return;
-    }
-    multinomialTable[particleNumber]->FillTo(newHighestN);
-}*/
-
 MultinomialTable::MultinomialTable(const unsigned char particleNumber): 
-	particleNumber(particleNumber), highestN(-1) {
-    // if (particleNumber < 0) {
-        // std::cerr << "Warning: MultinomialTable has been constructed with "
-            // << "particleNumber " << std::to_string(particleNumber) 
-            // << " < 0; your program is probably about to crash." << std::endl;
-    // }
+	particleNumber(particleNumber), highestN(-1), offsets(1, 0), 
+    partitionStride(1) {
 }
 
 // we fill this by constructing Pascal's simplex, in which each entry is the sum
 // of all entries on the previous level which can reach it
 //
 // we will not store any entries with the terms out of order, which is a 
-// generalization of the policy we used for binomials. We will also not store
-// any whose first term is the degree, since these are all 1 
+// generalization of the policy we used for binomials. Each new level of n is 
+// appended after the ones already there, which are left alone.
 void MultinomialTable::FillTo(const char newHighestN) {
     if (highestN >= newHighestN) return;
 
-    // first, generate the mVectors we need to compute the coefficients for
-    ComputeMVectors(newHighestN);
-    //std::cout << "mVectors constructed, now size " << mVectors.size() << std::endl;
-
-    table.emplace(std::string(particleNumber+1, 0), 1);
+    CountPartitions(newHighestN);
 
-    // the case with a single particle has to be handled differently because it
-    // wrecks the main loop
-    if (particleNumber == 1) {
-        for (const std::string& key : mVectors) table.emplace(key, 1);
-        highestN = newHighestN;
-        return;
-    }
-
-    // each key is the sum of the values of all lower keys which can produce it
-    for (std::string key : mVectors) {
-        if (key[0] == 0) {
-            //std::cout << "Emplacing " << MVectorOut(key) << " with value 1."
-                    //<< std::endl;
-            //table.emplace(std::move(key), 1);
+    const std::size_t width = particleNumber + 1;
+    for (char n = highestN + 1; n <= newHighestN; ++n) {
+        // with no particles, the only mVector is the empty one at n = 0
+        if (particleNumber == 0 && n > 0) {
+            offsets.push_back(coefficients.size());
+            highestN = n;
             continue;
         }
-        // std::cout << "Evaluating this key based on lower values: " 
-                // << MVectorOut(key) << std::endl;
-        highestN = std::max(highestN, key[0]);
-        coeff_class value = 0;
-        --key[0];
-        --key[1];
-        value += Lookup(key);
-        int i = 2;
-        while (i < particleNumber+1 && key[i] != 0) {
-            ++key[i-1];
-            --key[i];
-            try {
-                value += Lookup(key);
+
+        std::string key(width, 0);
+        key[0] = n;
+        if (particleNumber > 0) key[1] = n;
+        std::string lower;
+        do {
+            mVectors += key;
+            if (n == 0 || particleNumber == 1) {
+                coefficients.push_back(1);
+                continue;
             }
-            catch (std::out_of_range) {
-                std::cerr << "Error: attempted to look up " << MVectorOut(key)
-                        << " but it did not exist." << std::endl;
-                throw;
+            // the entries on the level below which can reach this one are
+            // those with one of the m's lowered by 1; lowering any entry of a
+            // run of equal m's gives the same sorted mVector, so each run only
+            // has to be looked up once, at its last entry (which keeps the
+            // lower mVector sorted)
+            coeff_class value = 0;
+            lower = key;
+            --lower[0];
+            std::size_t i = 1;
+            while (i < width && key[i] != 0) {
+                std::size_t j = i;
+                while (j+1 < width && key[j+1] == key[i]) ++j;
+                --lower[j];
+                value += static_cast<coeff_class>(j - i + 1)
+                       * coefficients[Index(lower.data())];
+                ++lower[j];
+                i = j + 1;
             }
-            ++i;
-        }
-        //--key[1];
-        ++key[0];
-        ++key[i-1];
-        if (value == 0) value = 1;
-        // std::cout << "Emplacing this key: " << MVectorOut(key) << 
-            // " with value: " << value << std::endl;
-        table.emplace(std::move(key), value);
+            coefficients.push_back(value);
+        } while (AdvanceMVector(key));
+        offsets.push_back(coefficients.size());
+        highestN = n;
     }
-    highestN = newHighestN;
 }
 
-// vector of all mVectors whose total "n" is exactly the supplied n
-//
-// if this turns out to be slow, we can avoid the copy by passing iterators to
-// a slightly reorganized container for the mVectors
-MVectorContainer MultinomialTable::GetMVectors(const unsigned char n) {
-    // std::cout << "Returning mVectors corresponding to n = " << (int)n
-        // << " from among the " << mVectors.size() << " known ones." << std::endl;
-    if (n == 0) {
-        // std::cout << "Someone is requesting the 0 mVector in "
-            // << int(particleNumber) << "particles." << std::endl;
-        return {std::string(particleNumber+1, 0)};
+// all mVectors whose total "n" is exactly the supplied n
+MVectorRange MultinomialTable::GetMVectors(const unsigned char n) const {
+    if (static_cast<char>(n) > highestN) {
+        throw std::out_of_range(__FILE__ ": asked for mVectors at n=" 
+                + std::to_string(n) + " from a table only filled to n=" 
+                + std::to_string(highestN));
     }
-    std::string lower(particleNumber+1, n);
-    std::string upper(particleNumber+1, 0);
-    upper[0] = n;
-    //std::cout << "Returning mVectors between " << MVectorOut(lower) << " and " 
-            //<< MVectorOut(upper) << std::endl;
+    MVectorRange range(this, offsets[n], offsets[n+1]);
     // the below is obviously only for safety, remove it if needed
-    if (MVectorContainer(mVectors.lower_bound(lower), 
-                         mVectors.upper_bound(upper)).size() == 0) {
+    if (range.empty()) {
         std::cerr << "WARNING: request for mVectors at (" << (int)particleNumber
             << ", " << (int)n << ") returned an empty set drawn from the total "
-            << "of " << mVectors.size() << " mVectors with n up to "
+            << "of " << coefficients.size() << " mVectors with n up to "
             << (int)highestN << "." << std::endl;
     }
-    return MVectorContainer(mVectors.lower_bound(lower), 
-                            mVectors.upper_bound(upper));
+    return range;
+}
+
+std::string MultinomialTable::MVector(const std::size_t index) const {
+    const std::size_t width = particleNumber + 1;
+    return mVectors.substr(index*width, width);
+}
+
+// the partition tables are laid out with b varying fastest, then k, then s
+std::size_t MultinomialTable::Slot(const int s, const int k, 
+                                   const int b) const {
+    return (s*(particleNumber + 1) + k)*partitionStride + b;
+}
+
+// fills in both partition tables for every s and b up to newHighestN; these are
+// small enough that they're just recomputed from scratch as the table grows
+void MultinomialTable::CountPartitions(const char newHighestN) {
+    const int N = newHighestN;
+    partitionStride = N + 1;
+    partitions.assign(partitionStride*(particleNumber + 1)*partitionStride, 0);
+    partitionsAbove.assign(partitions.size(), 0);
+    for (int s = 0; s <= N; ++s) {
+        for (int k = 0; k <= particleNumber; ++k) {
+            // either the largest part is below b, or it's exactly b
+            for (int b = 0; b <= N; ++b) {
+                std::size_t& count = partitions[Slot(s, k, b)];
+                if (s == 0) {
+                    count = 1;
+                } else if (k > 0 && b > 0) {
+                    count = partitions[Slot(s, k, b-1)];
+                    if (b <= s) count += partitions[Slot(s-b, k-1, b)];
+                }
+            }
+            // partitions whose first part is above v: first part v+1, or above
+            if (k == 0) continue;
+            for (int v = s-1; v >= 0; --v) {
+                partitionsAbove[Slot(s, k, v)] = partitionsAbove[Slot(s, k, v+1)]
+                                        + partitions[Slot(s-v-1, k-1, v+1)];
+            }
+        }
+    }
 }
 
-// computes all mVectors with n up to newHighestN
-void MultinomialTable::ComputeMVectors(const char newHighestN) {
-    // std::cout << "Computing mVectors for n = " << (int)newHighestN << std::endl;
-    mVectors.clear();
-    for (char n = newHighestN; n >= 0; --n) {
-        std::string mVector(particleNumber+1, 0);
-        mVector[0] = n;
-        mVector[1] = n;
-        do { 
-            // std::cout << "Emplacing an mVector: " << MVectorOut(mVector) 
-                    // << std::endl;
-            mVectors.emplace_hint(mVectors.begin(), mVector);
-        } while(AdvanceMVector(mVector));
+// position of a sorted mVector in the table: the offset of its n plus the
+// number of mVectors at that n which come before it, i.e. those which agree 
+// with it up to some m_i and then have a larger m_i (but no larger than the 
+// previous part or the remaining total)
+std::size_t MultinomialTable::Index(const char* sortedNAndM) const {
+    int s = sortedNAndM[0];
+    int bound = s;
+    std::size_t rank = offsets[s];
+    for (int i = 1; i <= particleNumber && s > 0; ++i) {
+        const int m = sortedNAndM[i];
+        const int k = particleNumber - i + 1;
+        rank += partitionsAbove[Slot(s, k, m)] 
+              - partitionsAbove[Slot(s, k, std::min(bound, s))];
+        s -= m;
+        bound = m;
     }
+    return rank;
 }
 
 // Advances mVector to the next configuration at the same n then returns true. 
@@ -245,15 +437,14 @@ bool MultinomialTable::AdvanceMVector(std::string& mVector) {
     return false;
 }
 
-coeff_class MultinomialTable::Choose(const char n, const std::vector<char>& m) {
+coeff_class MultinomialTable::Choose(const char n, 
+                                     const std::vector<char>& m) const {
     return Lookup(n + std::string(m.begin(), m.end()));
 }
 
 // the first entry of nAndm is n, followed by the m vector
-coeff_class MultinomialTable::Lookup(std::string nAndm) {
-    // std::cout << "Lookup of mVector " << MVectorOut(nAndm) << " with length "
-        // << nAndm.size() << std::endl;
-    if (nAndm.size() != particleNumber + 1) {
+coeff_class MultinomialTable::Lookup(const std::string& nAndm) const {
+    if (nAndm.size() != particleNumber + 1u) {
         std::cerr << "Error: asked to choose a multinomial with an m vector "
             << "whose size (" << nAndm.size()-1 << ") is different from the "
             << "number of particles (" << std::to_string(particleNumber) 
@@ -261,24 +452,32 @@ coeff_class MultinomialTable::Lookup(std::string nAndm) {
         return 0;
     }
 
-    // we're using the permutation symmetry to only store sorted coefficients
-    std::sort(nAndm.begin()+1, nAndm.end(), std::greater<char>());
-    if (nAndm[0] <  nAndm[1]) return 0;
-    // the below line should not be necessary, since the zero vectors should be
-    // emplaced in the table. I have no idea what the problem is
-    // if (nAndm[0] == nAndm[1]) return 1;
-    //if (nAndm[0] == nAndm[1] + 1) return nAndm[0];
-
-    if (nAndm[0] > highestN) {
-        // std::cerr << "Error: requested multinomial(" 
-            // << std::to_string(nAndm[0]) << ", m), but this table was only "
-            // << "filled up to " << std::to_string(highestN) << "." << std::endl;
-        // return -1;
-        FillTo(nAndm[0]);
+    // we're using the permutation symmetry to only store sorted coefficients;
+    // the mVectors handed out by GetMVectors are already sorted, so they're
+    // only copied if they've been permuted since
+    const char* key = nAndm.data();
+    std::string sorted;
+    if (!std::is_sorted(nAndm.begin()+1, nAndm.end(), std::greater<char>())) {
+        sorted = nAndm;
+        std::sort(sorted.begin()+1, sorted.end(), std::greater<char>());
+        key = sorted.data();
+    }
+    if (particleNumber > 0 && key[0] < key[1]) return 0;
+
+    int total = 0;
+    for (int i = 1; i <= particleNumber; ++i) total += key[i];
+    if (key[0] < 0 || total != key[0] || key[particleNumber] < 0) {
+        throw std::out_of_range("Multinomial::Lookup: " + MVectorOut(nAndm) 
+                                + " is not an mVector");
+    }
+
+    if (key[0] > highestN) {
+        throw std::out_of_range("Multinomial::Lookup: " + MVectorOut(nAndm) 
+                                + " is beyond the table, which is only filled "
+                                + "to n=" + std::to_string(highestN));
     }
 
-    // std::cout << "Looking up this mVector: " << MVectorOut(nAndm) << std::endl;
-    return table.at(nAndm);
+    return coefficients[Index(key)];
 }
 
 } // namespace Multinomial
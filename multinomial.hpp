@@ -2,10 +2,18 @@
 #define MULTINOMIAL_HPP
 
 #include <vector>
-#include <set>
+#include <string>
 #include <iostream>
+#include <iterator> // std::input_iterator_tag
+#include <algorithm> // std::sort, std::is_sorted
+#include <functional> // std::greater
+#include <stdexcept>
 #include <memory> // unique_ptr
-#include <unordered_map>
+#include <cstdint> // std::uint32_t
+#include <limits> // std::numeric_limits
+#include <array>
+#include <atomic>
+#include <mutex>
 
 #include "constants.hpp" // for coeff_class
 #include "io.hpp" // MVectorOut
@@ -13,45 +21,125 @@
 namespace Multinomial {
 
 class MultinomialTable;
+class MVectorRange;
 
-// sorts mVectors so their n goes up but the Ms go down
-struct MVectorPrecedence {
-    constexpr bool operator()(const std::string& A, const std::string& B) const;
-};
-typedef std::set<std::string, MVectorPrecedence> MVectorContainer;
+// Choose and Lookup take their coefficients from tables generated when 
+// compiling as long as they're within these, and only fall back on the
+// MultinomialTables (which are also what GetMVectors uses) beyond them
+constexpr int BINOMIAL_DEGREE = 64;
+constexpr int SMALL_PARTICLES = 8;
+constexpr int SMALL_DEGREE = 24;
+// particle numbers beyond this don't get a table
+constexpr int MAX_TABLE_PARTICLES = 64;
 
+// All of these can be called from any number of threads at once, except for 
+// Clear. The tables are grown when something beyond them is asked for, which
+// takes a lock; Precompute grows them ahead of time so that this never happens
+// during a parallel calculation.
 void Initialize(const char particleNumber, const char highestN);
+void Precompute(const char maxParticles, const char maxDegree);
 void Clear();
-std::unique_ptr<MultinomialTable>& GetTable(const std::size_t n, const char d);
-// void FillTo(const char particleNumber, const char newHighestN);
-MVectorContainer GetMVectors(const unsigned char particleNumber, const char n);
+const MultinomialTable* GetTable(const std::size_t n, const char d);
+MVectorRange GetMVectors(const unsigned char particleNumber, const char n);
 // first Choose is binomial, second is multinomial
 coeff_class Choose(const char n, const char m);
-coeff_class Choose(const char particleNumber, const char n, 
+coeff_class Choose(const char particleNumber, const char n,
 		const std::vector<char>& m);
 coeff_class Lookup(const char particleNumber, const std::string& nAndm);
 
+// The table holds every sorted mVector (n followed by m_1 >= m_2 >= ...) up to
+// highestN in one flat string, and their coefficients in a vector, both in the
+// order where n goes up but the Ms go down. An mVector's position is found by
+// counting the partitions which come before it rather than by searching, and
+// filling to a higher n only appends the new levels.
 class MultinomialTable {
     public:
         explicit MultinomialTable(const unsigned char particleNumber);
 
-        coeff_class Choose(const char n, const std::vector<char>& m);
-        coeff_class Lookup(std::string nAndm);
+        // these only read the table, and throw if n is beyond it
+        coeff_class Choose(const char n, const std::vector<char>& m) const;
+        coeff_class Lookup(const std::string& nAndm) const;
+        MVectorRange GetMVectors(const unsigned char n) const;
+
+        // only for tables which haven't been published (see Initialize)
         void FillTo(const char newHighestN);
-        MVectorContainer GetMVectors(const unsigned char n);
 
         char HighestN() const { return highestN; }
+        // number of mVectors, at every n up to highestN
+        std::size_t Size() const { return coefficients.size(); }
+
+        // the index'th mVector, counting from n = 0
+        std::string MVector(const std::size_t index) const;
 
     private:
         const unsigned char particleNumber;
-        MVectorContainer mVectors;
-        std::unordered_map<std::string, coeff_class> table;
         char highestN;
+        // particleNumber+1 chars per mVector
+        std::string mVectors;
+        std::vector<coeff_class> coefficients;
+        // index of the first mVector of each n, with one past the last at the end
+        std::vector<std::size_t> offsets;
+
+        // partitions[Slot(s, k, b)] is the number of partitions of s into at
+        // most k parts which are each at most b; partitionsAbove[Slot(s, k, v)]
+        // is the number of those into at most k parts whose first exceeds v
+        std::vector<std::size_t> partitions;
+        std::vector<std::size_t> partitionsAbove;
+        std::size_t partitionStride;
 
-        void ComputeMVectors(const char newHighestN);
+        std::size_t Slot(const int s, const int k, const int b) const;
+        void CountPartitions(const char newHighestN);
+        std::size_t Index(const char* sortedNAndM) const;
         static bool AdvanceMVector(std::string& mVector);
 };
 
+// The mVectors at a single n, as a view into their table instead of a copy.
+// A table is never changed once it's published, and the ones replaced by larger
+// tables are kept around, so a range stays valid until Clear. Dereferencing 
+// gives a new string.
+class MVectorRange {
+    public:
+        class const_iterator {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef std::string value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const std::string* pointer;
+                typedef std::string reference;
+
+                const_iterator(const MultinomialTable* table,
+                               const std::size_t index):
+                    table(table), index(index) {}
+
+                std::string operator*() const { return table->MVector(index); }
+                const_iterator& operator++() { ++index; return *this; }
+                bool operator==(const const_iterator& other) const {
+                    return index == other.index;
+                }
+                bool operator!=(const const_iterator& other) const {
+                    return index != other.index;
+                }
+
+            private:
+                const MultinomialTable* table;
+                std::size_t index;
+        };
+
+        MVectorRange(const MultinomialTable* table, const std::size_t first,
+                     const std::size_t last):
+            table(table), first(first), last(last) {}
+
+        const_iterator begin() const { return {table, first}; }
+        const_iterator end() const { return {table, last}; }
+        std::size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+
+    private:
+        const MultinomialTable* table;
+        std::size_t first;
+        std::size_t last;
+};
+
 } // namespace Multinomial
 
 #endif
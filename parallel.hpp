@@ -0,0 +1,48 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <vector>
+#include <algorithm> // std::min
+#include <functional> // std::function
+#include <thread>
+#include <atomic>
+#include <exception> // std::exception_ptr for errors from worker threads
+
+// call fillRow(i) for every i in [0, rows), using up to the given number of
+// threads (including this one). Rows are handed out one at a time rather than
+// in fixed chunks because their costs can differ by orders of magnitude. If
+// any call throws, the remaining rows are skipped and the exception is rethrown
+// here once all of the threads have stopped.
+inline void FillRows(const std::size_t rows, const unsigned int threads,
+                     const std::function<void(std::size_t)>& fillRow) {
+    std::size_t numThreads = std::min<std::size_t>(threads, rows);
+    if (numThreads <= 1) {
+        for (std::size_t i = 0; i < rows; ++i) fillRow(i);
+        return;
+    }
+
+    std::atomic<std::size_t> nextRow(0);
+    std::vector<std::exception_ptr> errors(numThreads);
+    auto worker = [&](const std::size_t threadIndex) {
+        try {
+            for (std::size_t i = nextRow++; i < rows; i = nextRow++) fillRow(i);
+        }
+        catch (...) {
+            errors[threadIndex] = std::current_exception();
+            // make the other threads run out of rows so we can rethrow ASAP
+            nextRow = rows;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < numThreads; ++t) workers.emplace_back(worker, t);
+    // the main thread does its share instead of just waiting around
+    worker(0);
+    for (auto& thread : workers) thread.join();
+
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+#endif
@@ -14,17 +14,55 @@ Poly::Poly(const std::vector<Mono>& terms){
     }
 }
 
+// position of x in terms, or terms.size() if it isn't there
+std::size_t Poly::Find(const Mono& x) const {
+    if (slots.empty()) return terms.size();
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = x.Hash() & mask; slots[i] != 0; i = (i+1) & mask) {
+        if (terms[slots[i]-1] == x) return slots[i]-1;
+    }
+    return terms.size();
+}
+
+void Poly::AddToIndex(const std::size_t position) {
+    if (2*terms.size() > slots.size()) {
+        Reindex();
+        return;
+    }
+    const std::size_t mask = slots.size() - 1;
+    std::size_t i = terms[position].Hash() & mask;
+    while (slots[i] != 0) i = (i+1) & mask;
+    slots[i] = position + 1;
+}
+
+void Poly::Reindex() {
+    std::size_t size = 16;
+    while (size < 2*terms.size()) size *= 2;
+    slots.assign(size, 0);
+    const std::size_t mask = size - 1;
+    for (std::size_t position = 0; position < terms.size(); ++position) {
+        std::size_t i = terms[position].Hash() & mask;
+        while (slots[i] != 0) i = (i+1) & mask;
+        slots[i] = position + 1;
+    }
+}
+
+// terms whose coefficients cancel are erased, which moves all of the ones after
+// them and so means reindexing, but that's no worse than the erase itself
 Poly& Poly::operator+=(const Mono& x){
     if(std::abs<builtin_class>(x.Coeff()) < EPSILON) return *this;
 
-    for(auto it = terms.begin(); it != terms.end(); ++it) {
-        if(*it == x){
-            it->Coeff() += x.Coeff();
-            if(std::abs<builtin_class>(it->Coeff()) < EPSILON) terms.erase(it);
-            return *this;
+    std::size_t position = Find(x);
+    if (position < terms.size()) {
+        terms[position].Coeff() += x.Coeff();
+        if(std::abs<builtin_class>(terms[position].Coeff()) < EPSILON) {
+            terms.erase(terms.begin() + position);
+            Reindex();
         }
+        return *this;
     }
     terms.push_back(x);
+    AddToIndex(terms.size() - 1);
     return *this;
 }
 
@@ -77,19 +115,13 @@ Poly Poly::operator-() const{
 }
 
 bool Poly::operator==(const Poly& other) const{
-    bool found;
     for(auto& term1 : terms){
-        found = false;
-        for(auto& term2 : other.terms){
-            if(term1 == term2){
-                if(std::abs<builtin_class>(term1.Coeff() - term2.Coeff()) > EPSILON) {
-                    return false;
-                }
-                found = true;
-                break;
-            }
+        std::size_t position = other.Find(term1);
+        if(position == other.terms.size()) return false;
+        const Mono& term2 = other.terms[position];
+        if(std::abs<builtin_class>(term1.Coeff() - term2.Coeff()) > EPSILON) {
+            return false;
         }
-        if(!found) return false;
     }
     return true;
 }
@@ -16,12 +16,27 @@
 // array. This can also be iterated through with begin() and end().
 // * The output stream operator std::cout << somePoly prints the Poly as a
 // sum of its constituent monos.
+// * The terms are indexed by their monos' hashes, so adding a mono to a Poly
+// takes constant time rather than a search through all of its terms. Because 
+// of this, terms accessed through [] or begin() can have their coefficients 
+// changed, but NOT their momenta.
 class Poly {
     std::vector<Mono> terms;
+    // open addressing table of positions in terms plus 1 (0 means the slot is 
+    // empty), probed linearly from each mono's Hash(); the size is 0 or a power
+    // of 2, and it's kept at most half full
+    std::vector<std::size_t> slots;
+
+    std::size_t Find(const Mono& x) const;
+    void AddToIndex(const std::size_t position);
+    void Reindex();
 
     public:
         explicit Poly() {}
-        explicit Poly(const Mono starter) { terms.push_back(starter); }
+        explicit Poly(const Mono starter) { 
+            terms.push_back(starter); 
+            AddToIndex(0);
+        }
         explicit Poly(const std::vector<Mono>& terms);
 
         Poly& operator+=(const Mono& x);
@@ -3,24 +3,25 @@
 namespace Test {
 
 bool RunAllTests(const Arguments& args) {
-    Multinomial::Initialize(1, 6);
-    Multinomial::Initialize(2, 6);
-    Multinomial::Initialize(3, 6);
-    Multinomial::Initialize(4, 6);
-    Multinomial::Initialize(5, 6);
-    Multinomial::Initialize(6, 6);
+    Multinomial::Precompute(6, 6);
 
     OStream& console = *args.console;
 
     console << "----- PERFORMING ALL AVAILABLE UNIT TESTS -----" << endl;
     bool result = true;
     result &= MatrixInternal::PermuteXY(console);
+    result &= MatrixInternal::PermutationOrbits(console);
     result &= MatrixInternal::InteractionTermsFromXY(console);
     result &= MatrixInternal::CombineInteractionFs(console);
     result &= MatrixInternal::Expand(console);
     result &= MatrixInternal::UPlusIntegral(console);
+    result &= MatrixInternal::ThetaIntegral_Short(console);
     // result &= RIntegral(console);
+    result &= MultinomialTable(console);
+    result &= ConcurrentMultinomials(console);
     result &= Hypergeometric(console);
+    result &= MonoKeys(console);
+    result &= PolyTerms(console);
 
     int numP = 3;
     int degree = 7;
@@ -36,11 +37,21 @@ bool RunAllTests(const Arguments& args) {
     std::vector<Poly> oddStates = ::Orthogonalize(allOddBases, console, true);
     Basis<Mono> minBasis = ::MinimalBasis(evenStates);
     // result &= Test::InteractionMatrix(minBasis, args);
+    result &= MatrixInternal::ContractDirect(minBasis, console);
 
     result &= MuPart_NtoN(args);
+    result &= PrecomputeMuParts(console);
+    result &= PiecewiseChebyshev(console);
+    result &= ThreadedMatrix(minBasis, console);
+    result &= ElementCache(minBasis, console);
+    result &= MatrixInternal::Operator(minBasis, console);
     result &= Midpoint_Rectangular(console);
     result &= Midpoint_Triangular(console);
     result &= Simpson_Rectangular(console);
+    result &= GaussJacobi_Rectangular(console);
+    result &= GaussJacobi_Triangular(console);
+    result &= Adaptive_Rectangular(console);
+    result &= Adaptive_Triangular(console);
 
     return result;
 }
@@ -62,6 +73,152 @@ bool PermuteXY(OStream& console) {
     return true;
 }
 
+namespace {
+// every distinct ordering of xAndy's particles, in the order PermuteXY gives
+std::vector<std::string> AllOrderings(std::string xAndy) {
+    // PermuteXY wraps around to the first ordering when it returns false
+    while (::MatrixInternal::PermuteXY(xAndy)) {}
+    std::vector<std::string> output;
+    do {
+        output.push_back(xAndy);
+    } while (::MatrixInternal::PermuteXY(xAndy));
+    return output;
+}
+
+coeff_class Degeneracy(const Mono& A, const Mono& B) {
+    coeff_class degeneracy = 1;
+    for (auto& count : A.CountIdentical()) degeneracy *= Factorial(count);
+    for (auto& count : B.CountIdentical()) degeneracy *= Factorial(count);
+    return degeneracy;
+}
+
+bool SameTerms(const ::MatrixInternal::NtoN_Final& orbits, 
+               const ::MatrixInternal::NtoN_Final& expected) {
+    builtin_class scale = 0;
+    for (const auto& term : expected) {
+        scale = std::max(scale, std::abs(static_cast<builtin_class>(
+                                                            term.second)));
+    }
+    for (const auto& term : orbits) {
+        auto other = expected.find(term.first);
+        coeff_class difference = term.second 
+            - (other == expected.end() ? 0 : other->second);
+        if (std::abs(static_cast<builtin_class>(difference)) > 1e-12*scale) {
+            return false;
+        }
+    }
+    for (const auto& term : expected) {
+        if (orbits.count(term.first) == 0 
+                && std::abs(static_cast<builtin_class>(term.second)) 
+                    > 1e-12*scale) {
+            return false;
+        }
+    }
+    return true;
+}
+} // anonymous namespace
+
+// summing over one representative of each orbit, weighted by its size, has to
+// agree with summing over every ordering of A and B (only of B for the direct
+// matrices), which is how the matrix terms were originally computed
+bool PermutationOrbits(OStream& console) {
+    console << "----- MatrixInternal::PermutationOrbits -----" << endl;
+    bool passed = true;
+
+    std::vector<std::array<Mono,2>> sameN{
+        {{Mono({2, 1, 1}, {0, 1, 1}), Mono({1, 1, 1}, {2, 0, 0})}},
+        {{Mono({3, 1, 1}, {0, 0, 0}), Mono({2, 2, 1}, {1, 1, 0})}},
+        {{Mono({1, 1, 1, 1}, {0, 0, 0, 0}), Mono({2, 1, 1, 1}, {0, 1, 1, 0})}},
+        {{Mono({2, 2, 1, 1}, {1, 0, 1, 0}), Mono({3, 1, 1, 1}, {0, 0, 0, 2})}}
+    };
+    for (const auto& pair : sameN) {
+        const Mono& A = pair[0];
+        const Mono& B = pair[1];
+        const std::string xAndy_A = ::MatrixInternal::ExtractXY(A);
+        const std::string xAndy_B = ::MatrixInternal::ExtractXY(B);
+
+        std::vector<::MatrixInternal::InteractionTerm_Step2> allFs;
+        coeff_class direct = 0;
+        for (const auto& orderingA : AllOrderings(xAndy_A)) {
+            for (const auto& orderingB : AllOrderings(xAndy_B)) {
+                auto combinedFs = ::MatrixInternal::CombineInteractionFs(
+                        ::MatrixInternal::InteractionTermsFromXY(orderingA),
+                        ::MatrixInternal::InteractionTermsFromXY(orderingB));
+                allFs.insert(allFs.end(), combinedFs.begin(), combinedFs.end());
+            }
+        }
+        for (const auto& orderingB : AllOrderings(xAndy_B)) {
+            direct += ::MatrixInternal::ContractDirect(
+                    ::MatrixInternal::DirectTrieFromXY(xAndy_A), 
+                    ::MatrixInternal::DirectTrieFromXY(orderingB), MAT_INNER);
+        }
+        ::MatrixInternal::CollectLikeTerms(allFs);
+        auto expected = ::MatrixInternal::InteractionOutput(allFs, 
+                Degeneracy(A, B)*A.Coeff()*B.Coeff()
+                * ::MatrixInternal::Prefactor(A, B, MAT_INTER_SAME_N));
+        if (!SameTerms(::MatrixInternal::MatrixTerm_NtoN(A, B), expected)) {
+            console << "MatrixTerm_NtoN(" << A << ", " << B << ") doesn't "
+                << "match the sum over all orderings" << endl;
+            passed = false;
+        }
+
+        // MatrixTerm_Direct's degeneracy has n_A! instead of A's identicals
+        direct *= Factorial(A.NParticles())*Degeneracy(A, B)*A.Coeff()*B.Coeff()
+                * ::MatrixInternal::Prefactor(A, B, MAT_INNER);
+        for (auto& count : A.CountIdentical()) direct /= Factorial(count);
+        coeff_class orbits = ::MatrixInternal::MatrixTerm_Direct(A, B, 
+                                                                 MAT_INNER);
+        if (std::abs(static_cast<builtin_class>(orbits - direct)) 
+                > 1e-12*std::abs(static_cast<builtin_class>(direct))) {
+            console << "MatrixTerm_Direct(" << A << ", " << B << ") == " 
+                << orbits << " != " << direct << endl;
+            passed = false;
+        }
+    }
+
+    std::vector<std::array<Mono,2>> nPlus2{
+        {{Mono({2, 1}, {0, 1}), Mono({1, 1, 1, 1}, {1, 1, 0, 0})}},
+        {{Mono({1, 1, 2}, {0, 0, 0}), Mono({2, 1, 1, 1, 1}, {0, 0, 0, 1, 1})}},
+        {{Mono({1, 1, 1}, {1, 1, 0}), Mono({1, 1, 1, 1, 1}, {1, 1, 0, 0, 0})}}
+    };
+    for (const auto& pair : nPlus2) {
+        const Mono& A = pair[0];
+        const Mono& B = pair[1];
+        const std::string xAndy_A = ::MatrixInternal::ExtractXY(A);
+        const std::string xAndy_B = ::MatrixInternal::ExtractXY(B);
+        std::vector<::MatrixInternal::NPlus2Term_Step2> allFs;
+        for (const auto& orderingA : AllOrderings(xAndy_A)) {
+            for (const auto& orderingB : AllOrderings(xAndy_B)) {
+                auto combinedFs = ::MatrixInternal::CombineNPlus2Fs(
+                        ::MatrixInternal::InteractionTermsFromXY(orderingA),
+                        ::MatrixInternal::InteractionTermsFromXY(orderingB));
+                allFs.insert(allFs.end(), combinedFs.begin(), combinedFs.end());
+            }
+        }
+        ::MatrixInternal::CollectLikeTerms(allFs);
+        auto addByExponents = [](
+                const std::vector<::MatrixInternal::NPlus2Term_Output>& terms) {
+            ::MatrixInternal::NtoN_Final output;
+            for (const auto& term : terms) {
+                output[{{term.r, term.alpha}}] += term.coeff;
+            }
+            return output;
+        };
+        auto expected = addByExponents(::MatrixInternal::NPlus2Output(allFs, 
+                Degeneracy(A, B)*A.Coeff()*B.Coeff()
+                * ::MatrixInternal::Prefactor(A, B, MAT_INTER_N_PLUS_2)));
+        auto orbits = addByExponents(::MatrixInternal::MatrixTerm_NPlus2(A, B));
+        if (!SameTerms(orbits, expected)) {
+            console << "MatrixTerm_NPlus2(" << A << ", " << B << ") doesn't "
+                << "match the sum over all orderings" << endl;
+            passed = false;
+        }
+    }
+
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool InteractionTermsFromXY(OStream& console) {
     console << "----- MatrixInternal::InteractionTermsFromXY -----" << endl;
     std::vector<std::string> testCases {
@@ -101,17 +258,17 @@ bool CombineInteractionFs(OStream& console) {
     // };
 
     // 4 particle
-    std::vector<std::vector<char>> uPlusCases {
+    std::vector<ExponentVector> uPlusCases {
         {5, 2, 2}, {5, 4, 0}, {4, 3, 2}, {5, 2, 2}, {5, 4, 0}, {4, 3, 2}, 
         {2, 2, 4}, {2, 4, 2}, {1, 3, 4}, {2, 2, 4}, {2, 6, 0}, {1, 5, 2}, 
         {0, 4, 4}, {2, 4, 2}, {1, 3, 4}
     };
-    std::vector<std::vector<char>> uMinusCases {
+    std::vector<ExponentVector> uMinusCases {
         {3, 0, 0}, {3, 0, 0}, {3, 1, 1}, {3, 0, 2}, {3, 0, 2}, {3, 1, 1}, 
         {8, 4, 4}, {8, 4, 2}, {8, 5, 3}, {8, 4, 2}, {8, 4, 4}, {8, 5, 3}, 
         {8, 6, 0}, {8, 4, 1}, {8, 5, 2}
     };
-    std::vector<std::vector<char>> yTildeCases {
+    std::vector<ExponentVector> yTildeCases {
         {1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 0, 1}, {1, 0, 1}, {0, 1, 1}, 
         {2, 0, 2}, {2, 0, 0}, {1, 1, 2}, {2, 0, 1}, {2, 0, 1}, {1, 1, 0}, 
         {0, 2, 2}, {2, 0, 1}, {1, 1, 1}
@@ -167,6 +324,69 @@ bool Expand(OStream& console) {
     return true;
 }
 
+// the trie contraction has to agree with integrating the combined terms one at
+// a time, for both the inner product and the mass matrix
+bool ContractDirect(const Basis<Mono>& basis, OStream& console) {
+    console << "----- MatrixInternal::ContractDirect -----" << endl;
+    bool passed = true;
+    for (std::size_t i = 0; i < basis.size(); ++i) {
+        std::string xAndy_A = ::MatrixInternal::ExtractXY(basis[i]);
+        const auto& fFromA = ::MatrixInternal::DirectTermsFromXY(xAndy_A);
+        ::MatrixInternal::TermTrie trieA(fFromA);
+        for (std::size_t j = 0; j < basis.size(); ++j) {
+            std::string xAndy_B = ::MatrixInternal::ExtractXY(basis[j]);
+            const auto& fFromB = ::MatrixInternal::DirectTermsFromXY(xAndy_B);
+            ::MatrixInternal::TermTrie trieB(fFromB);
+            for (MATRIX_TYPE type : {MAT_INNER, MAT_MASS}) {
+                auto combinedFs = ::MatrixInternal::CombineTwoFs(fFromA, fFromB);
+                coeff_class expected = ::MatrixInternal::FinalResult(combinedFs,
+                                                                     type);
+                coeff_class contracted = ::MatrixInternal::ContractDirect(
+                                                        trieA, trieB, type);
+                if (std::abs(static_cast<builtin_class>(contracted - expected))
+                        > 1e-12*std::abs(static_cast<builtin_class>(expected))){
+                    console << basis[i] << " x " << basis[j] << " (type " 
+                        << type << "): " << contracted << " != " << expected 
+                        << endl;
+                    passed = false;
+                }
+            }
+        }
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// the Kronecker form of each operator has to give the same matrix as Matrix, 
+// and the same polynomial matrix as multiplying by the discretized polynomials
+bool Operator(const Basis<Mono>& basis, OStream& console) {
+    console << "----- MatrixInternal::Operator -----" << endl;
+    bool passed = true;
+    constexpr std::size_t kMax = 5;
+    DMatrix polys(basis.size(), 2);
+    for (Eigen::Index i = 0; i < polys.rows(); ++i) {
+        polys(i, 0) = coeff_class(1) / (i + 1);
+        polys(i, 1) = (i % 3) - coeff_class(1);
+    }
+    SMatrix discPolys = DiscretizePolys(polys, kMax);
+    for (MATRIX_TYPE type : {MAT_MASS, MAT_KINETIC, MAT_INTER_SAME_N}) {
+        KroneckerSum op = ::MatrixInternal::Operator(basis, kMax, type, 2);
+        DMatrix matrix = ::MatrixInternal::Matrix(basis, kMax, type, 2);
+        DMatrix polyMatrix = discPolys.transpose()*matrix*discPolys;
+        DMatrix difference = op.Dense() - matrix;
+        DMatrix polyDifference = op.Project(polys).Dense() - polyMatrix;
+        coeff_class scale = matrix.cwiseAbs().maxCoeff();
+        if (difference.cwiseAbs().maxCoeff() > 1e-14*scale 
+                || polyDifference.cwiseAbs().maxCoeff() > 1e-12*scale) {
+            console << "operator of type " << type << " doesn't match its "
+                << "matrix" << endl;
+            passed = false;
+        }
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool UPlusIntegral(OStream& console) {
     console << "----- ::UPlusIntegral -----" << endl;
     bool passed = true;
@@ -183,6 +403,27 @@ bool UPlusIntegral(OStream& console) {
     }
 }
 
+// the integrals come from a table built by recurrence, which has to agree with
+// the Beta function everywhere, not just at a few points
+bool ThetaIntegral_Short(OStream& console) {
+    console << "----- ::ThetaIntegral_Short -----" << endl;
+    bool passed = true;
+    for (int a = 0; a < 60; ++a) {
+        for (int b = 0; b < 60; ++b) {
+            builtin_class answer = ::MatrixInternal::ThetaIntegral_Short(a, b);
+            builtin_class expected = (b%2 == 1 ? 0 : 
+                    gsl_sf_beta((a + 1.0)/2.0, (b + 1.0)/2.0));
+            if (std::abs(answer - expected) > 1e-12*expected) {
+                console << "ThetaIntegral_Short(" << a << ", " << b << ") == "
+                    << answer << " != " << expected << endl;
+                passed = false;
+            }
+        }
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool UPlusIntegral_Case(const builtin_class a, const builtin_class b, 
         const builtin_class expected, OStream& console) {
     constexpr builtin_class tol = 1e-5;
@@ -216,6 +457,187 @@ bool UPlusIntegral_Case(const builtin_class a, const builtin_class b,
     // return true;
 // }
 
+bool MultinomialTable_Case(const char particles, const std::string& nAndm, 
+                          OStream& console) {
+    coeff_class expected = Factorial(nAndm[0]);
+    for (int i = 1; i <= particles; ++i) expected /= Factorial(nAndm[i]);
+    coeff_class value = Multinomial::Lookup(particles, nAndm);
+    coeff_class tableValue = Multinomial::GetTable(particles, 
+                                                   nAndm[0])->Lookup(nAndm);
+    if (value != expected || tableValue != expected) {
+        console << "Lookup(" << MVectorOut(nAndm) << ") == " << value 
+            << " and " << tableValue << " != " << expected << endl;
+        return false;
+    }
+    return true;
+}
+
+// every coefficient should be n!/(m_1! m_2! ...), whichever order the m's are
+// given in, both from the compile-time tables and from the MultinomialTables; 
+// the latter are asked for one n at a time here so that they're regrown, each 
+// time at least doubling, with every level appended to the ones before it
+bool MultinomialTable(OStream& console) {
+    console << "----- Multinomial::MultinomialTable -----" << endl;
+    bool passed = true;
+    std::size_t checked = 0;
+    for (char particles = 1; particles <= 6; ++particles) {
+        for (char n = 0; n <= 12; ++n) {
+            for (std::string nAndm : Multinomial::GetMVectors(particles, n)) {
+                do {
+                    passed &= MultinomialTable_Case(particles, nAndm, console);
+                    ++checked;
+                } while (std::prev_permutation(nAndm.begin()+1, nAndm.end()));
+            }
+        }
+    }
+    console << "checked " << checked << " coefficients" << endl;
+
+    // a table replaced by a larger one stays readable
+    const Multinomial::MultinomialTable* smaller = Multinomial::GetTable(4, 12);
+    const Multinomial::MultinomialTable* larger 
+        = Multinomial::GetTable(4, smaller->HighestN() + 1);
+    if (larger->Size() < 2*smaller->Size()) {
+        console << "the 4-particle table only grew from " << smaller->Size() 
+            << " to " << larger->Size() << " mVectors" << endl;
+        passed = false;
+    }
+    passed &= smaller->Lookup(larger->MVector(smaller->Size() - 1)) 
+           == larger->Lookup(larger->MVector(smaller->Size() - 1));
+
+    // beyond the compile-time tables, in degree and in particle number
+    passed &= MultinomialTable_Case(3, {{32, 10, 11, 11}}, console);
+    passed &= MultinomialTable_Case(9, {{12, 3, 2, 2, 1, 1, 1, 1, 1, 0}}, console);
+
+    // the binomials switch over from Pascal's triangle to the tables at 
+    // BINOMIAL_DEGREE, which this stays below 2^63 past
+    for (char n = 1; n <= 66; ++n) {
+        for (char m = 0; m <= n; ++m) {
+            if (Multinomial::Choose(n, m) != Multinomial::Choose(n-1, m-1) 
+                                           + Multinomial::Choose(n-1, m)) {
+                console << "Choose(" << int(n) << ", " << int(m) << ") == " 
+                    << Multinomial::Choose(n, m) << " != Choose(n-1, m-1) + "
+                    << "Choose(n-1, m)" << endl;
+                passed = false;
+            }
+        }
+    }
+
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// monos built from the same particles in any order, or brought to the same
+// momenta by ChangePm and ChangePt, must be equal and have the same hash and 
+// stats, which must also match the ones counted from the particles
+bool MonoKeys(OStream& console) {
+    console << "----- ::Mono (keys and stats) -----" << endl;
+    bool passed = true;
+    std::vector<int> pm{3, 1, 1, 2, 0};
+    std::vector<int> pt{0, 2, 1, 0, 4};
+    const Mono reference(pm, pt);
+    std::vector<std::size_t> order{0, 1, 2, 3, 4};
+    while (std::next_permutation(order.begin(), order.end())) {
+        std::vector<int> permutedPm, permutedPt;
+        for (std::size_t i : order) {
+            permutedPm.push_back(pm[i]);
+            permutedPt.push_back(pt[i]);
+        }
+        Mono permuted(permutedPm, permutedPt);
+        if (permuted != reference || permuted.Hash() != reference.Hash()) {
+            console << permuted << " doesn't match " << reference << endl;
+            passed = false;
+        }
+    }
+
+    // neither of these moves the particle which is changed
+    Mono changed(reference.MultPm(0).MultPt(1));
+    changed.ChangePm(0, changed.Pm(0) - 1);
+    changed.ChangePt(1, changed.Pt(1) - 1);
+    if (changed != reference || changed.Hash() != reference.Hash()) {
+        console << changed << " doesn't match " << reference << " after "
+            << "changing its momenta back" << endl;
+        passed = false;
+    }
+    if (reference.MultPm(1) == reference 
+            || reference.MultPm(1).Hash() == reference.Hash()) {
+        console << reference.MultPm(1) << " matches " << reference << endl;
+        passed = false;
+    }
+
+    int totalPm = 0, totalPt = 0, maxPt = -1;
+    for (std::size_t i = 0; i < reference.NParticles(); ++i) {
+        totalPm += reference.Pm(i);
+        totalPt += reference.Pt(i);
+        maxPt = std::max<int>(maxPt, reference.Pt(i));
+    }
+    if (reference.TotalPm() != totalPm || reference.TotalPt() != totalPt
+            || reference.MaxPt() != maxPt || reference.MaxPm() != 3
+            || reference.Degree() != totalPm + totalPt) {
+        console << "stats of " << reference << " don't match its particles" 
+            << endl;
+        passed = false;
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// adding monos to a Poly must combine the ones which are already there and 
+// erase the ones which cancel, without losing track of the others
+bool PolyTerms(OStream& console) {
+    console << "----- ::Poly (terms) -----" << endl;
+    auto term = [](const int k) { 
+        return Mono(std::vector<int>{k/10 + 2, 1}, 
+                    std::vector<int>{k%10, 0}, k + 1);
+    };
+    constexpr int termCount = 200;
+    Poly poly;
+    for (int k = 0; k < termCount; ++k) poly += term(k);
+    // doubles the odd terms and cancels the even ones
+    for (int k = 0; k < termCount; ++k) {
+        if (k % 2 == 0) {
+            poly -= term(k);
+        } else {
+            poly += term(k);
+        }
+    }
+
+    bool passed = (poly.size() == termCount/2);
+    Poly expected;
+    for (int k = 1; k < termCount; k += 2) expected += 2*term(k);
+    passed &= (poly == expected && expected == poly);
+    for (std::size_t i = 0; i + 1 < poly.size(); ++i) {
+        // terms which survive keep the order in which they were first added
+        passed &= (poly[i].Coeff() < poly[i+1].Coeff());
+    }
+    passed &= (MinimalBasis({poly, expected}).size() == poly.size());
+    if (!passed) console << poly << "\n^ should be\n" << expected << endl;
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// tables grown from several threads at once, each reading mVectors out of 
+// tables which the others are replacing with larger ones, must still give the 
+// same coefficients
+bool ConcurrentMultinomials(OStream& console) {
+    console << "----- Multinomial (threaded) -----" << endl;
+    Multinomial::Clear();
+    constexpr std::size_t rows = 60;
+    std::vector<char> rowPassed(rows, true);
+    FillRows(rows, 8, [&](const std::size_t row) {
+        const char particles = 1 + row % 10;
+        const char n = 2 + (7*row) % 17;
+        for (const std::string& nAndm 
+                : Multinomial::GetMVectors(particles, n)) {
+            rowPassed[row] &= MultinomialTable_Case(particles, nAndm, console);
+        }
+    });
+    bool passed = std::all_of(rowPassed.begin(), rowPassed.end(), 
+                              [](const char p) { return p; });
+    Multinomial::Precompute(6, 6);
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool Hypergeometric(OStream& console) {
     console << "----- ::HypergeometricPFQ -----" << endl;
     bool passed = true;
@@ -236,6 +658,24 @@ bool Hypergeometric(OStream& console) {
     passed &= HypergeometricPFQ_Reg_Case<3,2>({{1,2,-3}}, {{-4,-5}}, 0.6, 0.0, console);
     passed &= HypergeometricPFQ_Reg_Case<3,2>({{1,2,3}}, {{-4,-5}}, 0.6, 4.61311e14, console);
 
+    // near x=1, 2F1 is done in terms of 1-x and the others are continued along
+    // their differential equation
+    passed &= HypergeometricPFQ_Reg_Case<2,1>({{0.5,0.5}}, {{1}}, 0.99, 2.35272, console);
+    passed &= HypergeometricPFQ_Reg_Case<2,1>({{0.3,0.7}}, {{0.6}}, 0.95, 2.00580, console);
+    passed &= HypergeometricPFQ_Reg_Case<2,1>({{-0.5,1}}, {{2}}, 0.99, 0.672727, console);
+    passed &= HypergeometricPFQ_Reg_Case<3,2>({{0.5,1.5,1.75}}, {{2,2.75}}, 0.85, 0.858433, console);
+    passed &= HypergeometricPFQ_Reg_Case<4,3>({{1,1,2.5,2.5}}, {{2,2,3}}, 0.85, 1.15855, console);
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<3,2>({{1.5,2.5,1.5}}, {{3.5,2}}, 0.99, 3.10195003825706, console);
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<3,2>({{1.5,2.5,1.5}}, {{3.5,2}}, 0.999, 5.21950123789858, console);
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<4,3>({{1,1,2.5,1.5}}, {{2,2,2}}, 0.999, 6.14163737272293, console);
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<3,2>({{0.5,1.5,1.75}}, {{2,2.75}}, 0.9999, 1.02275606499654, console);
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<3,2>({{0.5,1,-0.25}}, {{1.5,0.75}}, 0.999, 0.749449954523223, console);
+    // c-a-b too close to an integer for the 1-x series
+    passed &= HypergeometricPFQ_Reg_NearOne_Case<2,1>({{0.5,0.5}}, {{1.0005}}, 0.999, 3.07888281850571, console);
+
+    passed &= HypergeometricPFQ_Reg_Batch_Case<3,2>({{0.5,1.5,1.75}}, {{2,2.75}}, {{0, 0.25, 0.5, 0.75, 0.95, 1}}, console);
+    passed &= HypergeometricPFQ_Reg_Batch_Case<2,1>({{-1.5,0.5}}, {{-0.5}}, {{0.1, 0.4, 0.9}}, console);
+
     // argument x=1 requires special treatment that's not implemented yet
     // passed &= HypergeometricPFQ_Case<2,1>({{1,2}}, {{4}}, 1.0, 3.0, console);
     // passed &= HypergeometricPFQ_Reg_Case<2,1>({{1,2}}, {{4}}, 1.0, 0.5, console);
@@ -258,6 +698,51 @@ bool InteractionMatrix(const Basis<Mono>& basis, const Arguments& args) {
     return true;
 }
 
+// filling a matrix with several threads must give exactly the serial result
+bool ThreadedMatrix(const Basis<Mono>& basis, OStream& console) {
+    console << "----- ::MatrixInternal::Matrix (threaded) -----" << endl;
+    bool passed = true;
+    for (MATRIX_TYPE type : {MAT_MASS, MAT_INTER_SAME_N}) {
+        DMatrix serial = ::MatrixInternal::Matrix(basis, 5, type, 1);
+        DMatrix threaded = ::MatrixInternal::Matrix(basis, 5, type, 4);
+        if (serial != threaded) {
+            console << "matrix of type " << type << " changed when filled "
+                << "using 4 threads" << endl;
+            passed = false;
+        }
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// matrices computed from a cold cache and then read back from it must both be
+// exactly what they are without one
+bool ElementCache(const Basis<Mono>& basis, OStream& console) {
+    console << "----- ::ElementCache -----" << endl;
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path("3dBasis-test-%%%%-%%%%");
+    bool passed = true;
+    for (MATRIX_TYPE type : {MAT_INNER, MAT_MASS, MAT_INTER_SAME_N}) {
+        DMatrix uncached = ::MatrixInternal::Matrix(basis, 5, type, 1);
+        ::ElementCache::Open(dir.string());
+        DMatrix cold = ::MatrixInternal::Matrix(basis, 5, type, 4);
+        DMatrix warm = ::MatrixInternal::Matrix(basis, 5, type, 4);
+        ::ElementCache::Close();
+        if (cold != uncached || warm != uncached) {
+            console << "matrix of type " << type << " changed when using the "
+                << "element cache" << endl;
+            passed = false;
+        }
+    }
+    if (boost::filesystem::is_empty(dir)) {
+        console << "nothing was written to the element cache" << endl;
+        passed = false;
+    }
+    boost::filesystem::remove_all(dir);
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool MuPart_NtoN(const Arguments& args) {
     OStream& console = *args.console;
     console << "----- ::MuPart_NtoN -----" << endl;
@@ -280,6 +765,115 @@ bool MuPart_NtoN(const Arguments& args) {
     }
 }
 
+// tables filled ahead of time by several threads must be exactly the ones 
+// MuPart_NtoN and MuPart_NPlus2 compute on demand, and tables for different
+// numbers of partitions must not be confused with each other
+bool PrecomputeMuParts(OStream& console) {
+    console << "----- ::PrecomputeMuParts -----" << endl;
+    bool passed = true;
+    // 4 partitions so that nothing earlier has already cached these tables
+    constexpr std::size_t partitions = 4;
+    const builtin_class partWidth = builtin_class(1) / partitions;
+    std::vector<std::array<char,2>> exponents{{{0, 0}}, {{1, 2}}, {{2, 0}}};
+    ::PrecomputeMuPart_NtoN(3, exponents, partitions, 4);
+    for (const auto& e : exponents) {
+        // n=3 leaves the exponents of alpha and r as 2*e[0] and e[1]
+        std::array<char,2> transformed{{static_cast<char>(2*e[0]), e[1]}};
+        DMatrix expected = DMatrix::Zero(partitions, partitions);
+        for (std::size_t a = 0; a < partitions; ++a) {
+            std::array<builtin_class,2> winA{{a*partWidth, (a+1)*partWidth}};
+            expected(a, a) = ::NtoNWindow_Equal(transformed, winA);
+            for (std::size_t b = a+1; b < partitions; ++b) {
+                std::array<builtin_class,2> winB{{b*partWidth, 
+                                                  (b+1)*partWidth}};
+                expected(a, b) = ::NtoNWindow_Less(transformed, winA, winB);
+            }
+        }
+        expected *= GKNorm(partitions);
+        if (::MuPart_NtoN(3, e, partitions) != expected) {
+            console << "precomputed MuPart_NtoN table for exponents " << e 
+                << " doesn't match the one computed directly" << endl;
+            passed = false;
+        }
+    }
+
+    std::vector<std::array<char,2>> nrs{{{1, 0}}, {{3, 0}}, {{3, 2}}, {{7, 1}}};
+    ::PrecomputeMuPart_NPlus2(nrs, partitions, 4);
+    for (const auto& nr : nrs) {
+        const DMatrix& table = ::MuPart_NPlus2(nr, partitions);
+        if (table.cols() != static_cast<Eigen::Index>(partitions)
+                || !table.allFinite()) {
+            console << "precomputed MuPart_NPlus2 table for " << nr
+                << " is malformed" << endl;
+            passed = false;
+            continue;
+        }
+        // n=1 is a single row of closed-form entries, not made of windows
+        if (nr[0] == 1) continue;
+        DMatrix expected = DMatrix::Zero(partitions, partitions);
+        for (std::size_t a = 0; a < partitions; ++a) {
+            expected(a, a) = ::NPlus2Window_Equal(nr[0], nr[1], a*partWidth, 
+                                                  (a+1)*partWidth);
+            std::array<builtin_class,2> winA{{a*partWidth, (a+1)*partWidth}};
+            for (std::size_t b = a+1; b < partitions; ++b) {
+                std::array<builtin_class,2> winB{{b*partWidth, 
+                                                  (b+1)*partWidth}};
+                expected(a, b) = ::NPlus2Window_Less(nr[0], nr[1], winA, winB);
+            }
+        }
+        expected *= GKNorm(partitions);
+        coeff_class scale = expected.cwiseAbs().maxCoeff();
+        if ((table - expected).cwiseAbs().maxCoeff() > 1e-12*scale) {
+            console << "precomputed MuPart_NPlus2 table for " << nr 
+                << " doesn't match the one computed directly" << endl;
+            passed = false;
+        }
+    }
+
+    for (std::size_t k : {3, 5, 3}) {
+        if (::MuPart_NtoN(2, {{0, 0}}, k).rows() != static_cast<Eigen::Index>(k)) {
+            console << "MuPart_NtoN for n=2 ignored its number of partitions" 
+                << endl;
+            passed = false;
+        }
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
+// the interpolants of the MuPart kernels have to reproduce a function with the
+// same logarithmic singularity at x = 1, and leave the last bit before 1 alone
+bool PiecewiseChebyshev(OStream& console) {
+    console << "----- ::PiecewiseChebyshev -----" << endl;
+    bool passed = true;
+    auto kernel = [](const std::vector<builtin_class>& x) {
+        std::vector<coeff_class> values;
+        ::HypergeometricPFQ_Reg_Batch<2,1>({{0.5, 0.5}}, {{1.0}}, x, values);
+        return values;
+    };
+    ::PiecewiseChebyshev interpolant(kernel, 1e-9);
+    console << "2F1(1/2, 1/2; 1; x) fit with " << interpolant.Pieces() 
+        << " pieces" << endl;
+
+    std::vector<builtin_class> x;
+    for (int k = 0; k < 999; ++k) x.push_back(k / 1000.0);
+    std::vector<coeff_class> expected = kernel(x);
+    for (std::size_t k = 0; k < x.size(); ++k) {
+        coeff_class error = interpolant(x[k]) - expected[k];
+        if (!(std::abs(static_cast<builtin_class>(error/expected[k])) < 1e-8)) {
+            console << "interpolant(" << x[k] << ") == " << interpolant(x[k]) 
+                << " != " << expected[k] << endl;
+            passed = false;
+        }
+    }
+    if (!std::isnan(static_cast<builtin_class>(interpolant(0.9999)))) {
+        console << "interpolant covers x = 0.9999, too close to 1" << endl;
+        passed = false;
+    }
+    console << (passed ? "----- PASSED -----" : "----- FAILED -----") << endl;
+    return passed;
+}
+
 bool Midpoint_Rectangular(OStream& console) {
     console << "----- ::Midpoint_Rectangular -----" << endl;
     bool pass = true;
@@ -411,4 +1005,188 @@ bool Simpson_Rectangular_Case(
     }
 }
 
+// the integrands here have the same singularities as those of the n=5 (n+2)
+// windows, (1 - mu1/mu2)^a sqrt(mu1)/mu2, but with values of a and domains for
+// which the integrals can be done analytically
+bool GaussJacobi_Rectangular(OStream& console) {
+    console << "----- ::GaussJacobi_Rectangular -----" << endl;
+    auto integrand = [](builtin_class mu1, builtin_class mu2)
+                     { return (1.0 - mu1/mu2)*std::sqrt(mu1)/mu2; };
+    bool pass = true;
+    pass &= GaussJacobi_Rectangular_Case(integrand, {{0, 0.5}}, {{1, 2}}, 
+                                         0.5, 1, 0.1280210182, console);
+    pass &= GaussJacobi_Rectangular_Case(integrand, {{0.5, 1}}, {{1, 3}}, 
+                                         0.5, 1, 0.2539365781, console);
+    pass &= GaussJacobi_Rectangular_Case(integrand, {{0, 1}}, {{1, 2}}, 
+                                         0.5, 1, 0.2620981204, console);
+    if (pass) {
+        console << "----- PASSED -----" << endl;
+        return true;
+    } else {
+        console << "----- FAILED -----" << endl;
+        return false;
+    }
+}
+
+bool GaussJacobi_Rectangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2> mu_a, 
+        const std::array<builtin_class,2> mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class expected, OStream& console) {
+    constexpr builtin_class tolerance = 1e-8;
+    constexpr std::size_t nodes = 16;
+
+    builtin_class answer = ::GaussJacobi_Rectangular(integrand, mu_a, mu_b, 
+                                    axisPower, diagonalPower, nodes);
+    console << "GaussJacobi_Rectangular(" << mu_a << ", " << mu_b << ") == " 
+        << answer;
+    if (std::abs(answer - expected) <= tolerance*answer) {
+        console << " == " << expected << " (PASS)" << endl;
+        return true;
+    } else {
+        console << " != " << expected << " (FAIL)" << endl;
+        return false;
+    }
+}
+
+bool GaussJacobi_Triangular(OStream& console) {
+    console << "----- ::GaussJacobi_Triangular -----" << endl;
+    bool pass = true;
+    pass &= GaussJacobi_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                { return std::pow(1.0 - mu1/mu2, 0.5)*std::sqrt(mu1)/mu2; },
+                0, 2, 0.5, 0.5, -0.5, 0.7404804897, console);
+    pass &= GaussJacobi_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                { return std::pow(1.0 - mu1/mu2, 1.5)*std::sqrt(mu1)/mu2; },
+                0, 3, 0.5, 1.5, -0.5, 0.6801747616, console);
+    pass &= GaussJacobi_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                { return (1.0 - mu1/mu2)*std::sqrt(mu1)/mu2; },
+                1, 2, 0.5, 1, -0.5, 0.06295559069, console);
+    if (pass) {
+        console << "----- PASSED -----" << endl;
+        return true;
+    } else {
+        console << "----- FAILED -----" << endl;
+        return false;
+    }
+}
+
+bool GaussJacobi_Triangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class scalingPower,
+        const builtin_class expected, OStream& console) {
+    constexpr builtin_class tolerance = 1e-8;
+    constexpr std::size_t nodes = 16;
+
+    builtin_class answer = ::GaussJacobi_Triangular(integrand, mu_a, mu_b, 
+                                    axisPower, diagonalPower, scalingPower, 
+                                    nodes);
+    console << "GaussJacobi_Triangular(" << mu_a << ", " << mu_b << ") == " 
+        << answer;
+    if (std::abs(answer - expected) <= tolerance*answer) {
+        console << " == " << expected << " (PASS)" << endl;
+        return true;
+    } else {
+        console << " != " << expected << " (FAIL)" << endl;
+        return false;
+    }
+}
+
+// the same integrals as for GaussJacobi_Rectangular, along with a smooth one,
+// but now the rule has to find the singularities by itself
+bool Adaptive_Rectangular(OStream& console) {
+    console << "----- ::Adaptive_Rectangular -----" << endl;
+    auto integrand = [](builtin_class mu1, builtin_class mu2)
+                     { return (1.0 - mu1/mu2)*std::sqrt(mu1)/mu2; };
+    bool pass = true;
+    pass &= Adaptive_Rectangular_Case([](builtin_class mu1, builtin_class mu2)
+                            { return std::exp(mu1 - mu2); },
+                            {{0.2, 20}}, {{6, 12}}, 1.19962e6, console);
+    pass &= Adaptive_Rectangular_Case(integrand, {{0, 0.5}}, {{1, 2}}, 
+                                      0.1280210182, console);
+    pass &= Adaptive_Rectangular_Case(integrand, {{0, 1}}, {{1, 2}}, 
+                                      0.2620981204, console);
+    if (pass) {
+        console << "----- PASSED -----" << endl;
+        return true;
+    } else {
+        console << "----- FAILED -----" << endl;
+        return false;
+    }
+}
+
+// passes if the answer is right and the error estimate is both within the 
+// tolerance and no smaller than the actual error
+bool Adaptive_Rectangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2> mu_a, 
+        const std::array<builtin_class,2> mu_b,
+        const builtin_class expected, OStream& console) {
+    constexpr builtin_class tolerance = 1e-8;
+    // the expected values are only known to this many digits
+    const builtin_class precision = expected < 1e3 ? 1e-9 : 1e-5;
+
+    CubatureResult result = ::Adaptive_Rectangular(integrand, mu_a, mu_b, 
+                                                   0, tolerance);
+    builtin_class answer = static_cast<builtin_class>(result.value);
+    builtin_class error = static_cast<builtin_class>(result.error);
+    console << "Adaptive_Rectangular(" << mu_a << ", " << mu_b << ") == " 
+        << answer << " +/- " << error;
+    if (std::abs(answer - expected) <= error + precision*answer
+            && error <= tolerance*answer) {
+        console << " == " << expected << " (PASS)" << endl;
+        return true;
+    } else {
+        console << " != " << expected << " (FAIL)" << endl;
+        return false;
+    }
+}
+
+bool Adaptive_Triangular(OStream& console) {
+    console << "----- ::Adaptive_Triangular -----" << endl;
+    bool pass = true;
+    pass &= Adaptive_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                            { return std::exp(mu1 - mu2); },
+                            0.2, 20.0, 18.8, console);
+    pass &= Adaptive_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                { return std::pow(1.0 - mu1/mu2, 0.5)*std::sqrt(mu1)/mu2; },
+                0, 2, 0.7404804897, console);
+    pass &= Adaptive_Triangular_Case([](builtin_class mu1, builtin_class mu2)
+                { return (1.0 - mu1/mu2)*std::sqrt(mu1)/mu2; },
+                1, 2, 0.06295559069, console);
+    if (pass) {
+        console << "----- PASSED -----" << endl;
+        return true;
+    } else {
+        console << "----- FAILED -----" << endl;
+        return false;
+    }
+}
+
+bool Adaptive_Triangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class expected, OStream& console) {
+    constexpr builtin_class tolerance = 1e-8;
+    // the expected values are only known to this many digits
+    const builtin_class precision = expected < 10 ? 1e-9 : 1e-3;
+
+    CubatureResult result = ::Adaptive_Triangular(integrand, mu_a, mu_b, 
+                                                  0, tolerance);
+    builtin_class answer = static_cast<builtin_class>(result.value);
+    builtin_class error = static_cast<builtin_class>(result.error);
+    console << "Adaptive_Triangular(" << mu_a << ", " << mu_b << ") == " 
+        << answer << " +/- " << error;
+    if (std::abs(answer - expected) <= error + precision*answer
+            && error <= tolerance*answer) {
+        console << " == " << expected << " (PASS)" << endl;
+        return true;
+    } else {
+        console << " != " << expected << " (FAIL)" << endl;
+        return false;
+    }
+}
+
 } // namespace Test
@@ -11,6 +11,7 @@
 #include "discretization.hpp"
 #include "gram-schmidt.hpp"
 #include "hypergeo.hpp"
+#include "element_cache.hpp"
 
 // This file contains unit tests for various functions; for a function named
 // Namespace::Function, the test will be Test::Namespace::Function, and will be
@@ -25,18 +26,32 @@ bool RunAllTests(const Arguments& args);
 namespace MatrixInternal {
 
 bool PermuteXY(OStream& console);
+bool PermutationOrbits(OStream& console);
 bool InteractionTermsFromXY(OStream& console);
 bool CombineInteractionFs(OStream& console);
 bool Expand(OStream& console);
+bool ContractDirect(const Basis<Mono>& basis, OStream& console);
+bool Operator(const Basis<Mono>& basis, OStream& console);
 bool UPlusIntegral(OStream& console);
+bool ThetaIntegral_Short(OStream& console);
 bool UPlusIntegral_Case(const builtin_class a, const builtin_class b, 
         const builtin_class expected, OStream& console);
 
 } // namespace MatrixInternal
 
+bool MultinomialTable(OStream& console);
+bool MultinomialTable_Case(const char particles, const std::string& nAndm,
+        OStream& console);
+bool ConcurrentMultinomials(OStream& console);
 bool Hypergeometric(OStream& console);
+bool MonoKeys(OStream& console);
+bool PolyTerms(OStream& console);
 bool InteractionMatrix(const Basis<Mono>& basis, const Arguments& args);
+bool ThreadedMatrix(const Basis<Mono>& basis, OStream& console);
+bool ElementCache(const Basis<Mono>& basis, OStream& console);
 bool MuPart_NtoN(const Arguments& args);
+bool PrecomputeMuParts(OStream& console);
+bool PiecewiseChebyshev(OStream& console);
 
 bool Midpoint_Rectangular(OStream& console);
 bool Midpoint_Rectangular_Case(
@@ -55,6 +70,31 @@ bool Simpson_Rectangular_Case(
         const std::array<builtin_class,2> mu_a, 
         const std::array<builtin_class,2> mu_b,
         const builtin_class expected, OStream& console);
+bool GaussJacobi_Rectangular(OStream& console);
+bool GaussJacobi_Rectangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2> mu_a, 
+        const std::array<builtin_class,2> mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class expected, OStream& console);
+bool GaussJacobi_Triangular(OStream& console);
+bool GaussJacobi_Triangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class axisPower, const builtin_class diagonalPower,
+        const builtin_class scalingPower,
+        const builtin_class expected, OStream& console);
+bool Adaptive_Rectangular(OStream& console);
+bool Adaptive_Rectangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const std::array<builtin_class,2> mu_a, 
+        const std::array<builtin_class,2> mu_b,
+        const builtin_class expected, OStream& console);
+bool Adaptive_Triangular(OStream& console);
+bool Adaptive_Triangular_Case(
+        std::function<coeff_class(builtin_class,builtin_class)> integrand,
+        const builtin_class mu_a, const builtin_class mu_b,
+        const builtin_class expected, OStream& console);
 
 // templates for testing templates --------------------------------------------
 
@@ -92,6 +132,56 @@ bool HypergeometricPFQ_Reg_Case(std::array<builtin_class,P> a,
     }
 }
 
+// the batch evaluator should give the same answers as one call per argument
+template<int P, int Q>
+bool HypergeometricPFQ_Reg_Batch_Case(std::array<builtin_class,P> a, 
+        std::array<builtin_class,Q> b, std::vector<builtin_class> xs,
+        OStream& console) {
+    constexpr coeff_class tol = 1e-8;
+    std::vector<coeff_class> answers;
+    ::HypergeometricPFQ_Reg_Batch<P,Q>(a, b, xs, answers);
+    bool passed = true;
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        coeff_class expected = ::HypergeometricPFQ_Reg<P,Q>(a, b, xs[i]);
+        console << "HypergeometricPFQ_Reg_Batch<" << P << "," << Q << ">(" << a 
+            << ", " << b << ", " << xs[i] << ") == " << answers[i];
+        if (std::abs(static_cast<builtin_class>(answers[i] - expected)) 
+                <= tol*std::abs(static_cast<builtin_class>(expected))) {
+            console << " == " << expected << " (PASS)" << endl;
+        } else {
+            console << " != " << expected << " (FAIL)" << endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// near x=1 the answer should be accurate to better than the series' stopping
+// criterion allows, and shouldn't take thousands of terms to get there
+template<int P, int Q>
+bool HypergeometricPFQ_Reg_NearOne_Case(std::array<builtin_class,P> a, 
+        std::array<builtin_class,Q> b, builtin_class x, coeff_class expected,
+        OStream& console) {
+    constexpr coeff_class tol = 1e-9;
+    constexpr unsigned long long maxTerms = 1000;
+    unsigned long long termsBefore = HypergeometricStats().terms;
+    coeff_class answer = ::HypergeometricPFQ_Reg<P,Q>(a, b, x);
+    unsigned long long terms = HypergeometricStats().terms - termsBefore;
+    console << "HypergeometricPFQ_Reg<" << P << "," << Q << ">(" << a 
+        << ", " << b << ", " << x << ") == " << answer << " in " << terms 
+        << " terms";
+    if (std::abs(static_cast<builtin_class>(answer - expected)) 
+            <= tol*std::abs(static_cast<builtin_class>(expected))
+            && terms <= maxTerms) {
+        console << " (PASS)" << endl;
+        return true;
+    } else {
+        console << "; expected " << expected << " in at most " << maxTerms 
+            << " (FAIL)" << endl;
+        return false;
+    }
+}
+
 } // namespace Test
 
 #endif